@@ -0,0 +1,263 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "book.h"
+#include "round.h"
+#include "wordindex.h"
+
+/* What write_book needs while it searches one length group. */
+struct book_builder {
+    struct word_group *group;
+    int depth; /* Guesses the book covers */
+    int *ids[MAX_BOOK_DEPTH + 1]; /* The candidates after each guess of the sequence */
+    int *spare; /* Scratch space for partitioning */
+    struct arena arena;
+    struct book_node *nodes; /* The nodes built so far */
+    uint32_t num_nodes;
+    uint32_t max_nodes; /* Number of nodes nodes has room for */
+};
+
+
+/* Round size up to the next multiple of 8. */
+static uint64_t align8(uint64_t size) {
+    return (size + 7) & ~(uint64_t) 7;
+}
+
+
+/* Return a hash of the words of index, length by length, so a book is only
+   used with the dictionary it was built from.
+*/
+static uint64_t hash_words(struct word_index *index) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (int len = 0; len <= index->max_length; len++) {
+        struct word_group *group = &index->groups[len];
+        for (int i = 0; i < group->num_words; i++) {
+            for (char *p = group->words[i]; ; p++) {
+                hash = (hash ^ (unsigned char) *p) * 0x100000001b3ULL;
+                if (*p == '\0') {
+                    break;
+                }
+            }
+        }
+    }
+    return hash;
+}
+
+
+/* Add num zeroed nodes to the builder and return the index of the first. */
+static uint32_t add_nodes(struct book_builder *b, int num) {
+    if (b->num_nodes + num > b->max_nodes) {
+        b->max_nodes = 2 * (b->num_nodes + num);
+        b->nodes = realloc(b->nodes, b->max_nodes * sizeof(struct book_node));
+        if (b->nodes == NULL) {
+            perror("realloc");
+            exit(1);
+        }
+    }
+    memset(b->nodes + b->num_nodes, 0, num * sizeof(struct book_node));
+    b->num_nodes += num;
+    return b->num_nodes - num;
+}
+
+
+/* Build the children of node, whose candidates are ids[level][first], ...,
+   ids[level][first + n - 1] in word order after the letters in guessed.
+   Each letter's family is the one partition_round keeps, found the same
+   way on a copy of the candidates, so games played from the book are the
+   games played without it.
+*/
+static void build_children(struct book_builder *b, uint32_t node, int level, int first, int n,
+                           uint32_t guessed) {
+    uint32_t children = add_nodes(b, NUM_LETTERS);
+    b->nodes[node].children = children;
+    for (int c = 0; c < NUM_LETTERS; c++) {
+        if (guessed & ((uint32_t) 1 << c)) {
+            continue;
+        }
+        struct partition part;
+        memcpy(b->ids[level + 1] + first, b->ids[level] + first, n * sizeof(int));
+        reset_arena(&b->arena);
+        partition_range(&b->arena, get_letter_column(b->group, 'a' + c), b->ids[level + 1],
+                        b->spare, first, n, NULL, &part);
+        int f = part.biggest, start = part.starts[f];
+        b->nodes[children + c].mask = part.masks[f];
+        b->nodes[children + c].count = part.counts[f];
+        if (level + 1 < b->depth && part.counts[f] > 1) {
+            build_children(b, children + c, level + 1, start, part.counts[f],
+                           guessed | (uint32_t) 1 << c);
+        }
+    }
+}
+
+
+/* Compile the opening book of index for sequences of up to depth guesses
+   and write it to filename. Lengths without mask columns are left out.
+*/
+void write_book(struct word_index *index, char *filename, int depth) {
+    struct book_builder b;
+    int max_ids = 1;
+    for (int len = 0; len <= index->max_length; len++) {
+        if (index->groups[len].num_words > max_ids) {
+            max_ids = index->groups[len].num_words;
+        }
+    }
+    b.depth = depth;
+    for (int level = 0; level <= depth; level++) {
+        b.ids[level] = malloc(max_ids * sizeof(int));
+        if (b.ids[level] == NULL) {
+            perror("malloc");
+            exit(1);
+        }
+    }
+    b.spare = malloc(max_ids * sizeof(int));
+    uint32_t *roots = calloc(index->max_length + 1, sizeof(uint32_t));
+    if (b.spare == NULL || roots == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+    init_arena(&b.arena, partition_scratch_size(max_ids));
+    b.nodes = NULL;
+    b.num_nodes = b.max_nodes = 0;
+    add_nodes(&b, 1);
+
+    for (int len = 1; len <= index->max_length; len++) {
+        b.group = &index->groups[len];
+        if (b.group->num_words == 0 || b.group->masks == NULL) {
+            continue;
+        }
+        roots[len] = add_nodes(&b, 1);
+        b.nodes[roots[len]].count = b.group->num_words;
+        for (int i = 0; i < b.group->num_words; i++) {
+            b.ids[0][i] = i;
+        }
+        if (depth > 0 && b.group->num_words > 1) {
+            build_children(&b, roots[len], 0, 0, b.group->num_words, 0);
+        }
+    }
+
+    struct book_header hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, BOOK_MAGIC, sizeof(hdr.magic));
+    hdr.version = BOOK_VERSION;
+    hdr.depth = depth;
+    hdr.num_words = index->groups[index->max_length].first + index->groups[index->max_length].num_words;
+    hdr.max_length = index->max_length;
+    hdr.dict_hash = hash_words(index);
+    hdr.roots_offset = align8(sizeof(hdr));
+    hdr.nodes_offset = align8(hdr.roots_offset + (index->max_length + 1) * sizeof(uint32_t));
+    hdr.num_nodes = b.num_nodes;
+    hdr.book_size = hdr.nodes_offset + (uint64_t) b.num_nodes * sizeof(struct book_node);
+
+    FILE *fp = fopen(filename, "wb");
+    if (fp == NULL) {
+        perror(filename);
+        exit(1);
+    }
+    static const char zeros[8];
+    uint64_t roots_size = (index->max_length + 1) * sizeof(uint32_t);
+    if (fwrite(&hdr, sizeof(hdr), 1, fp) != 1
+        || fwrite(zeros, 1, hdr.roots_offset - sizeof(hdr), fp) != hdr.roots_offset - sizeof(hdr)
+        || fwrite(roots, 1, roots_size, fp) != roots_size
+        || fwrite(zeros, 1, hdr.nodes_offset - hdr.roots_offset - roots_size, fp)
+           != hdr.nodes_offset - hdr.roots_offset - roots_size
+        || fwrite(b.nodes, sizeof(struct book_node), b.num_nodes, fp) != b.num_nodes) {
+        fprintf(stderr, "Could not write to %s\n", filename);
+        exit(1);
+    }
+    if (fclose(fp) != 0) {
+        perror("fclose");
+        exit(1);
+    }
+
+    for (int level = 0; level <= depth; level++) {
+        free(b.ids[level]);
+    }
+    free(b.spare);
+    free(b.nodes);
+    free(roots);
+    free_arena(&b.arena);
+}
+
+
+/* Report that filename is not a valid book for the dictionary and exit. */
+static void bad_book(char *filename, char *reason) {
+    fprintf(stderr, "%s: invalid opening book: %s\n", filename, reason);
+    exit(1);
+}
+
+
+/* Map the opening book in filename read-only and return it. The book must
+   have been built from the words of index. Only the header and the roots
+   are read now; the nodes are paged in as games reach them.
+*/
+struct book *load_book(char *filename, struct word_index *index) {
+    int fd = open(filename, O_RDONLY);
+    if (fd == -1) {
+        perror(filename);
+        exit(1);
+    }
+    struct stat sbuf;
+    if (fstat(fd, &sbuf) == -1) {
+        perror("fstat");
+        exit(1);
+    }
+    if ((uint64_t) sbuf.st_size < sizeof(struct book_header)) {
+        bad_book(filename, "truncated header");
+    }
+    char *base = mmap(NULL, sbuf.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        perror("mmap");
+        exit(1);
+    }
+    close(fd);
+
+    struct book_header *hdr = (struct book_header *) base;
+    uint64_t size = sbuf.st_size;
+    if (memcmp(hdr->magic, BOOK_MAGIC, sizeof(hdr->magic)) != 0 || hdr->version != BOOK_VERSION) {
+        bad_book(filename, "unsupported version");
+    }
+    if (hdr->book_size != size
+        || hdr->roots_offset + ((uint64_t) hdr->max_length + 1) * sizeof(uint32_t) > size
+        || hdr->nodes_offset + (uint64_t) hdr->num_nodes * sizeof(struct book_node) > size
+        || hdr->depth > MAX_BOOK_DEPTH) {
+        bad_book(filename, "section out of bounds");
+    }
+    int num_words = index->groups[index->max_length].first + index->groups[index->max_length].num_words;
+    if (hdr->max_length != (uint32_t) index->max_length || hdr->num_words != (uint32_t) num_words
+        || hdr->dict_hash != hash_words(index)) {
+        bad_book(filename, "built from another dictionary");
+    }
+
+    struct book *book = malloc(sizeof(struct book));
+    if (book == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+    book->base = base;
+    book->size = size;
+    book->depth = hdr->depth;
+    book->max_length = hdr->max_length;
+    book->roots = (uint32_t *) (base + hdr->roots_offset);
+    book->nodes = (struct book_node *) (base + hdr->nodes_offset);
+    book->num_nodes = hdr->num_nodes;
+    for (int len = 0; len <= book->max_length; len++) {
+        if (book->roots[len] >= hdr->num_nodes) {
+            bad_book(filename, "section out of bounds");
+        }
+    }
+    return book;
+}
+
+
+/* Unmap the book and deallocate it. */
+void deallocate_book(struct book *book) {
+    if (munmap(book->base, book->size) == -1) {
+        perror("munmap");
+        exit(1);
+    }
+    free(book);
+}
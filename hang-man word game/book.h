@@ -0,0 +1,69 @@
+#ifndef BOOK_H
+#define BOOK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* An opening book is a binary file compiled from a dictionary by mkbook.
+   For every playable word length and every sequence of up to depth distinct
+   guesses, it holds the family the biggest-family adversary keeps, so the
+   first guesses of a game, which always face a whole length group, are
+   answered by lookup instead of by partitioning. The book is mapped
+   read-only, so its pages are only read in as games reach them and every
+   process using it shares one copy.
+
+   Layout, with every section starting on an 8-byte boundary:
+     header      struct book_header
+     roots       max_length + 1 uint32_t: the node of the empty sequence
+                 of each length, or 0 if the length is not in the book
+     nodes       num_nodes struct book_node; node 0 is unused
+
+   The children of a node are NUM_LETTERS consecutive nodes, one per letter;
+   the child of a letter already guessed is unused.
+*/
+
+#define BOOK_MAGIC "WORDBOOK"
+#define BOOK_VERSION 1
+
+/* Deepest book mkbook builds. */
+#define MAX_BOOK_DEPTH 4
+
+struct book_header {
+    char magic[8]; /* BOOK_MAGIC, not NUL-terminated */
+    uint32_t version; /* BOOK_VERSION */
+    uint32_t depth; /* Guesses the book covers */
+    uint32_t num_words; /* Number of words of the dictionary */
+    uint32_t max_length; /* Length of the longest word */
+    uint64_t dict_hash; /* Hash of the dictionary's words, by length */
+    uint64_t book_size; /* Size of the whole book in bytes */
+    uint64_t roots_offset; /* Start of each section, from the start of the book */
+    uint64_t nodes_offset;
+    uint32_t num_nodes;
+    uint32_t unused;
+};
+
+/* The family kept after a sequence of guesses. */
+struct book_node {
+    uint64_t mask; /* Signature of the last guess's family */
+    uint32_t count; /* Number of candidates left */
+    uint32_t children; /* First of the NUM_LETTERS children, or 0 if the book ends here */
+};
+
+/* A mapped opening book. */
+struct book {
+    char *base; /* The mapping */
+    size_t size; /* Size of the mapping */
+    int depth; /* Guesses the book covers */
+    int max_length; /* Length of the longest word */
+    uint32_t *roots;
+    struct book_node *nodes;
+    uint32_t num_nodes;
+};
+
+struct word_index;
+
+void write_book(struct word_index *index, char *filename, int depth);
+struct book *load_book(char *filename, struct word_index *index);
+void deallocate_book(struct book *book);
+
+#endif
@@ -0,0 +1,320 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "candset.h"
+#include "family.h"
+
+/* The best family found so far by a split. */
+struct split {
+    int num_fams; /* Families found */
+    int biggest; /* Words in the biggest family */
+    int last; /* Last word of the biggest family */
+    uint64_t mask; /* Signature of the biggest family */
+    int want_last; /* 1 if ties are broken by last word, as partition_round does */
+};
+
+
+/* Return the bitset of group for letter 'a' + c at position j. */
+static uint64_t *position_bits(struct bit_group *group, int c, int j) {
+    return group->positions + ((size_t) c * group->words->length + j) * group->num_blocks;
+}
+
+
+/* Build and return the position bitsets of the groups of index that have
+   signatures; words longer than that cannot be played.
+*/
+struct bit_index *build_bit_index(struct word_index *index) {
+    struct bit_index *bits = malloc(sizeof(struct bit_index));
+    if (bits == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+    bits->max_length = index->max_length;
+    bits->max_blocks = 1;
+    bits->max_scratch = 1;
+    bits->groups = calloc(index->max_length + 1, sizeof(struct bit_group));
+    if (bits->groups == NULL) {
+        perror("calloc");
+        exit(1);
+    }
+
+    for (int len = 1; len <= index->max_length && len <= MAX_SIGNATURE_BITS; len++) {
+        struct bit_group *group = &bits->groups[len];
+        struct word_group *words = &index->groups[len];
+        group->words = words;
+        group->num_blocks = (words->num_words + 63) / 64;
+        if (words->num_words == 0) {
+            continue;
+        }
+        group->positions = calloc((size_t) NUM_LETTERS * len * group->num_blocks, sizeof(uint64_t));
+        if (group->positions == NULL) {
+            perror("calloc");
+            exit(1);
+        }
+        for (int i = 0; i < words->num_words; i++) {
+            char *word = words->words[i];
+            for (int j = 0; j < len; j++) {
+                if (word[j] >= 'a' && word[j] <= 'z') {
+                    position_bits(group, word[j] - 'a', j)[i / 64] |= (uint64_t) 1 << (i % 64);
+                }
+            }
+        }
+        if (group->num_blocks > bits->max_blocks) {
+            bits->max_blocks = group->num_blocks;
+        }
+        if ((len + 1) * group->num_blocks > bits->max_scratch) {
+            bits->max_scratch = (len + 1) * group->num_blocks;
+        }
+    }
+    return bits;
+}
+
+
+/* Return the bitsets of the words of the given length, or NULL if there are
+   none or they cannot be played.
+*/
+struct bit_group *get_bit_group(struct bit_index *bits, int length) {
+    if (length < 1 || length > bits->max_length || bits->groups[length].positions == NULL) {
+        return NULL;
+    }
+    return &bits->groups[length];
+}
+
+
+/* Deallocate the bitsets; the word_index they were built from is not freed. */
+void deallocate_bit_index(struct bit_index *bits) {
+    for (int len = 0; len <= bits->max_length; len++) {
+        free(bits->groups[len].positions);
+    }
+    free(bits->groups);
+    free(bits);
+}
+
+
+/* Allocate everything set needs to play games over any group of bits. */
+void init_candset(struct candset *set, struct bit_index *bits) {
+    set->bits = malloc(bits->max_blocks * sizeof(uint64_t));
+    set->pattern = malloc(bits->max_length + 1);
+    if (set->bits == NULL || set->pattern == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+    set->group = NULL;
+    set->num_words = 0;
+}
+
+
+/* Allocate scratch memory for splitting candidate sets of any group of bits. */
+void init_candset_scratch(struct candset_scratch *scratch, struct bit_index *bits) {
+    scratch->levels = malloc(bits->max_scratch * sizeof(uint64_t));
+    if (scratch->levels == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+}
+
+
+/* Start a game over the words of group: every word is a candidate and
+   nothing is revealed.
+*/
+void start_candset(struct candset *set, struct bit_group *group) {
+    int n = group->words->num_words;
+    set->group = group;
+    set->num_words = n;
+    memset(set->bits, 0xff, group->num_blocks * sizeof(uint64_t));
+    if (n % 64 != 0) {
+        set->bits[group->num_blocks - 1] = ((uint64_t) 1 << (n % 64)) - 1;
+    }
+    memset(set->pattern, '-', group->words->length);
+    set->pattern[group->words->length] = '\0';
+}
+
+
+/* Return the index of the last word in the bitset bits of num_blocks blocks,
+   which must not be empty.
+*/
+static int last_word(const uint64_t *bits, int num_blocks) {
+    int b = num_blocks - 1;
+    while (bits[b] == 0) {
+        b--;
+    }
+    return b * 64 + 63 - __builtin_clzll(bits[b]);
+}
+
+
+/* Find the families of the count candidates in the bitset set for letter
+   'a' + c that share the signature bits prefix, whose bits below position j
+   are decided, and add them to split.
+
+   The search goes down one position at a time, splitting the words with the
+   letter there from those without; the bitsets of each position's words
+   with the letter go in levels. Branches with no words end at once, and a
+   branch that keeps all words reuses its parent's bitset, so the work is
+   proportional to the families times the positions they differ in.
+*/
+static void split_candset(struct bit_group *group, int c, int j, uint64_t prefix,
+                          const uint64_t *set, int count, uint64_t *levels, struct split *split) {
+    int length = group->words->length, num_blocks = group->num_blocks;
+    if (j == length) {
+        split->num_fams++;
+        if (count > split->biggest) {
+            split->biggest = count;
+            split->mask = prefix;
+            split->last = split->want_last ? last_word(set, num_blocks) : 0;
+        } else if (count == split->biggest && split->want_last) {
+            int last = last_word(set, num_blocks);
+            if (last < split->last) {
+                split->last = last;
+                split->mask = prefix;
+            }
+        }
+        return;
+    }
+
+    const uint64_t *pos = position_bits(group, c, j);
+    uint64_t *child = levels;
+    int with = 0;
+    for (int b = 0; b < num_blocks; b++) {
+        child[b] = set[b] & pos[b];
+        with += __builtin_popcountll(child[b]);
+    }
+    if (with == count) {
+        split_candset(group, c, j + 1, prefix | (uint64_t) 1 << j, set, count, levels, split);
+        return;
+    }
+    if (with > 0) {
+        split_candset(group, c, j + 1, prefix | (uint64_t) 1 << j, child, with,
+                      levels + num_blocks, split);
+        for (int b = 0; b < num_blocks; b++) {
+            child[b] = set[b] & ~pos[b];
+        }
+        split_candset(group, c, j + 1, prefix, child, count - with, levels + num_blocks, split);
+    } else {
+        split_candset(group, c, j + 1, prefix, set, count, levels, split);
+    }
+}
+
+
+/* Return the number of words of the bitset set of set's group that have
+   signature mask for letter, and store them in kept.
+*/
+static int select_family(struct candset *set, const uint64_t *bits, char letter, uint64_t mask,
+                         uint64_t *kept) {
+    struct bit_group *group = set->group;
+    int count = 0;
+    memcpy(kept, bits, group->num_blocks * sizeof(uint64_t));
+    for (int j = 0; j < group->words->length; j++) {
+        const uint64_t *pos = position_bits(group, letter - 'a', j);
+        if ((mask >> j) & 1) {
+            for (int b = 0; b < group->num_blocks; b++) {
+                kept[b] &= pos[b];
+            }
+        } else {
+            for (int b = 0; b < group->num_blocks; b++) {
+                kept[b] &= ~pos[b];
+            }
+        }
+    }
+    for (int b = 0; b < group->num_blocks; b++) {
+        count += __builtin_popcountll(kept[b]);
+    }
+    return count;
+}
+
+
+/* Shrink the candidates of set to the count words of kept, the family with
+   signature mask for letter, and reveal letter where the family has it.
+*/
+static uint64_t keep_candset(struct candset *set, char letter, uint64_t mask,
+                             const uint64_t *kept, int count) {
+    if (kept != set->bits) {
+        memcpy(set->bits, kept, set->group->num_blocks * sizeof(uint64_t));
+    }
+    set->num_words = count;
+    for (int j = 0; j < set->group->words->length; j++) {
+        if ((mask >> j) & 1) {
+            set->pattern[j] = letter;
+        }
+    }
+    return mask;
+}
+
+
+/* Split the candidates of set by their signature for letter and keep the
+   biggest family; ties go to the family that got there first, as with
+   partition_round, which plays the same game. Reveal letter in the pattern
+   where the family has it, and return the family's signature mask.
+*/
+uint64_t partition_candset(struct candset *set, char letter, struct candset_scratch *scratch) {
+    struct split split = {0, 0, 0, 0, 1};
+    split_candset(set->group, letter - 'a', 0, 0, set->bits, set->num_words, scratch->levels, &split);
+    int count = select_family(set, set->bits, letter, split.mask, scratch->levels);
+    return keep_candset(set, letter, split.mask, scratch->levels, count);
+}
+
+
+/* Like partition_candset, but keep the family with signature mask, as chosen
+   by an adversary. If there is no such family, keep the biggest.
+*/
+uint64_t partition_candset_keep(struct candset *set, char letter, uint64_t mask,
+                                struct candset_scratch *scratch) {
+    int count = select_family(set, set->bits, letter, mask, scratch->levels);
+    if (count == 0) {
+        return partition_candset(set, letter, scratch);
+    }
+    return keep_candset(set, letter, mask, scratch->levels, count);
+}
+
+
+/* Fill stats[c] with the number of families and the size of the biggest
+   family that guessing letter 'a' + c would split the candidates of set
+   into, for every letter not yet guessed (letters_guessed[c] is 0);
+   the same as get_letter_stats for a round.
+*/
+void get_candset_stats(struct candset *set, char *letters_guessed,
+                       struct letter_stats stats[NUM_LETTERS], struct candset_scratch *scratch) {
+    for (int c = 0; c < NUM_LETTERS; c++) {
+        stats[c].num_fams = stats[c].biggest = 0;
+        if (letters_guessed[c]) {
+            continue;
+        }
+        struct split split = {0, 0, 0, 0, 0};
+        split_candset(set->group, c, 0, 0, set->bits, set->num_words, scratch->levels, &split);
+        stats[c].num_fams = split.num_fams;
+        stats[c].biggest = split.biggest;
+    }
+}
+
+
+/* Return candidate i of set, 0 <= i < num_words, counting in word order. */
+char *get_candset_word(struct candset *set, int i) {
+    int b = 0;
+    while (i >= __builtin_popcountll(set->bits[b])) {
+        i -= __builtin_popcountll(set->bits[b]);
+        b++;
+    }
+    uint64_t block = set->bits[b];
+    while (i-- > 0) {
+        block &= block - 1;
+    }
+    return set->group->words->words[b * 64 + __builtin_ctzll(block)];
+}
+
+
+/* Return a random candidate of set. Use rand, seeded by init_family. */
+char *get_random_candset_word(struct candset *set) {
+    return get_candset_word(set, rand() % set->num_words);
+}
+
+
+/* Deallocate all memory acquired by init_candset. */
+void deallocate_candset(struct candset *set) {
+    free(set->bits);
+    free(set->pattern);
+}
+
+
+/* Deallocate all memory acquired by init_candset_scratch. */
+void deallocate_candset_scratch(struct candset_scratch *scratch) {
+    free(scratch->levels);
+}
@@ -0,0 +1,67 @@
+#ifndef CANDSET_H
+#define CANDSET_H
+
+#include <stdint.h>
+#include "round.h"
+#include "wordindex.h"
+
+/* The position bitsets of one word_group: one bit per word of the group for
+   every letter and position. Bit i of block b of the bitset of letter and
+   position j is set if word 64 * b + i of the group has letter at position j;
+   that bitset starts at positions[((letter - 'a') * length + j) * num_blocks].
+*/
+struct bit_group {
+    struct word_group *words; /* The words the bits stand for */
+    int num_blocks; /* Number of 64-bit blocks of a bitset over the group */
+    uint64_t *positions; /* NUM_LETTERS * length bitsets; NULL if not playable */
+};
+
+/* The position bitsets of every playable group of a word_index. They are
+   read-only once built, so any number of games on any threads share them.
+*/
+struct bit_index {
+    int max_length; /* Length of the longest word */
+    int max_blocks; /* Blocks of a bitset over the biggest group */
+    int max_scratch; /* Blocks of scratch a split of any group needs */
+    struct bit_group *groups; /* groups[len] holds the bitsets of length len */
+};
+
+/* The state of one game of evil hangman as a set of candidates with one bit
+   per word of the group. A guess splits the set by signature with AND and
+   popcount over the position bitsets, so its cost scales with the group
+   size over 64, and a game holds only its bitset and pattern: a few
+   kilobytes even for the biggest groups.
+*/
+struct candset {
+    struct bit_group *group; /* The words of the game */
+    uint64_t *bits; /* Bit w is set if word w of the group is a candidate */
+    int num_words; /* Number of candidates */
+    char *pattern; /* The word as revealed so far; each blank is a - */
+};
+
+/* Memory a guess needs while it splits a candidate set. Games played in turn
+   on one thread can share one.
+*/
+struct candset_scratch {
+    uint64_t *levels; /* One bitset per position of the longest playable word, plus one */
+};
+
+struct bit_index *build_bit_index(struct word_index *index);
+struct bit_group *get_bit_group(struct bit_index *bits, int length);
+void deallocate_bit_index(struct bit_index *bits);
+
+void init_candset(struct candset *set, struct bit_index *bits);
+void start_candset(struct candset *set, struct bit_group *group);
+uint64_t partition_candset(struct candset *set, char letter, struct candset_scratch *scratch);
+uint64_t partition_candset_keep(struct candset *set, char letter, uint64_t mask,
+                                struct candset_scratch *scratch);
+void get_candset_stats(struct candset *set, char *letters_guessed,
+                       struct letter_stats stats[NUM_LETTERS], struct candset_scratch *scratch);
+char *get_candset_word(struct candset *set, int i);
+char *get_random_candset_word(struct candset *set);
+void deallocate_candset(struct candset *set);
+
+void init_candset_scratch(struct candset_scratch *scratch, struct bit_index *bits);
+void deallocate_candset_scratch(struct candset_scratch *scratch);
+
+#endif
@@ -0,0 +1,88 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <malloc.h>
+#include "reading.h"
+#include "util.h"
+
+/* Report the load time and heap footprint of load_dictionary for synthetic
+   dictionaries of 10^5, 10^6 and 10^7 words (or the sizes given as arguments).
+   Words are random lowercase strings of 2 to 15 letters.
+
+   To compile the program:
+          make dictbench
+*/
+
+#define REPEATS 3
+
+/* Return the number of bytes currently allocated on the heap. */
+size_t heap_in_use(void) {
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+}
+
+/* Write num_words random words to a new temporary file and return its name. */
+char *make_dictionary(long num_words) {
+    static char name[] = "/tmp/dictbenchXXXXXX";
+    strcpy(name, "/tmp/dictbenchXXXXXX");
+    int fd = mkstemp(name);
+    if (fd == -1) {
+        perror("mkstemp");
+        exit(1);
+    }
+    FILE *fp = fdopen(fd, "w");
+    if (fp == NULL) {
+        perror("fdopen");
+        exit(1);
+    }
+    char word[17];
+    for (long i = 0; i < num_words; i++) {
+        int len = 2 + rand() % 14;
+        for (int j = 0; j < len; j++) {
+            word[j] = 'a' + rand() % 26;
+        }
+        word[len] = '\n';
+        fwrite(word, 1, len + 1, fp);
+    }
+    if (fclose(fp) != 0) {
+        perror("fclose");
+        exit(1);
+    }
+    return name;
+}
+
+int main(int argc, char **argv) {
+    long default_sizes[] = {100000, 1000000, 10000000};
+    int num_sizes = argc > 1 ? argc - 1 : 3;
+
+    srand(1);
+    printf("%10s %12s %10s %14s %10s\n", "words", "file bytes", "load ms", "heap bytes", "heap/word");
+    for (int s = 0; s < num_sizes; s++) {
+        long num_words = argc > 1 ? strtol(argv[s + 1], NULL, 10) : default_sizes[s];
+        char *filename = make_dictionary(num_words);
+
+        double best = 0;
+        size_t heap = 0, file_bytes = 0;
+        for (int r = 0; r < REPEATS; r++) {
+            size_t before = heap_in_use();
+            long start = now_ns();
+            struct dictionary *dict = load_dictionary(filename);
+            double t = (now_ns() - start) / 1e9;
+            heap = heap_in_use() - before;
+            file_bytes = dict->arena_size - 1;
+            if (dict->num_words != num_words) {
+                fprintf(stderr, "Loaded %d words, expected %ld\n", dict->num_words, num_words);
+                exit(1);
+            }
+            deallocate_dictionary(dict);
+            if (r == 0 || t < best) {
+                best = t;
+            }
+        }
+        printf("%10ld %12zu %10.2f %14zu %10.2f\n", num_words, file_bytes, best * 1000,
+               heap, (double) heap / num_words);
+        unlink(filename);
+    }
+    return 0;
+}
@@ -0,0 +1,219 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "dictimage.h"
+#include "family.h"
+#include "reading.h"
+#include "wordindex.h"
+
+
+/* Round size up to the next multiple of 8. */
+static uint64_t align8(uint64_t size) {
+    return (size + 7) & ~(uint64_t) 7;
+}
+
+
+/* Return 1 if the file open on fd starts like a dictionary image. */
+int is_dict_image(int fd) {
+    char magic[sizeof(((struct dict_image_header *) 0)->magic)];
+    if (pread(fd, magic, sizeof(magic), 0) != sizeof(magic)) {
+        return 0;
+    }
+    return memcmp(magic, DICT_IMAGE_MAGIC, sizeof(DICT_IMAGE_MAGIC)) == 0;
+}
+
+
+/* Report that filename is not a valid image and exit. */
+static void bad_image(char *filename, char *reason) {
+    fprintf(stderr, "%s: invalid dictionary image: %s\n", filename, reason);
+    exit(1);
+}
+
+
+/* Return 1 if a section of length bytes at offset lies within an image of
+   size bytes and starts on an 8-byte boundary.
+*/
+static int section_fits(uint64_t offset, uint64_t length, uint64_t size) {
+    return offset % 8 == 0 && offset <= size && length <= size - offset;
+}
+
+
+/* Map the dictionary image open on fd read-only and return a dictionary that
+   points into it. fd is closed. The words are not parsed or copied, but every
+   bucket and word offset is checked against the pool, so a corrupt image is
+   rejected here instead of being read out of bounds later.
+*/
+struct dictionary *map_dict_image(int fd, char *filename) {
+    struct stat sbuf;
+    if (fstat(fd, &sbuf) == -1) {
+        perror("fstat");
+        exit(1);
+    }
+    if ((uint64_t) sbuf.st_size < sizeof(struct dict_image_header)) {
+        bad_image(filename, "truncated header");
+    }
+    char *image = mmap(NULL, sbuf.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (image == MAP_FAILED) {
+        perror("mmap");
+        exit(1);
+    }
+    close(fd);
+
+    struct dict_image_header *hdr = (struct dict_image_header *) image;
+    uint64_t size = sbuf.st_size;
+    if (hdr->version != DICT_IMAGE_VERSION) {
+        bad_image(filename, "unsupported version");
+    }
+    if (hdr->image_size != size) {
+        bad_image(filename, "size does not match header");
+    }
+    if (!section_fits(hdr->pool_offset, hdr->pool_size, size)
+        || !section_fits(hdr->offsets_offset, (uint64_t) hdr->num_words * sizeof(uint32_t), size)
+        || !section_fits(hdr->buckets_offset, ((uint64_t) hdr->max_length + 2) * sizeof(uint32_t), size)) {
+        bad_image(filename, "section out of bounds");
+    }
+    if (hdr->pool_size == 0 || image[hdr->pool_offset + hdr->pool_size - 1] != '\0') {
+        bad_image(filename, "unterminated string pool");
+    }
+
+    struct dictionary *dict = calloc(1, sizeof(struct dictionary));
+    if (dict == NULL) {
+        perror("calloc");
+        exit(1);
+    }
+    dict->arena = image + hdr->pool_offset;
+    dict->arena_size = hdr->pool_size;
+    dict->offsets = (uint32_t *) (image + hdr->offsets_offset);
+    dict->num_words = hdr->num_words;
+    dict->max_length = hdr->max_length;
+    dict->buckets = (uint32_t *) (image + hdr->buckets_offset);
+    if (dict->buckets[0] != 0 || dict->buckets[hdr->max_length + 1] != hdr->num_words) {
+        bad_image(filename, "length buckets do not cover the words");
+    }
+    // Every word of length len must end with its NUL inside the pool, so
+    // reading len + 1 bytes of it never leaves the pool.
+    for (uint32_t len = 0; len <= hdr->max_length; len++) {
+        if (dict->buckets[len] > dict->buckets[len + 1]) {
+            bad_image(filename, "length buckets out of order");
+        }
+        for (uint32_t i = dict->buckets[len]; i < dict->buckets[len + 1]; i++) {
+            if ((uint64_t) dict->offsets[i] + len >= hdr->pool_size
+                || dict->arena[dict->offsets[i] + len] != '\0') {
+                bad_image(filename, "word outside the string pool");
+            }
+        }
+    }
+    if (hdr->flags & DICT_IMAGE_HAS_MASKS) {
+        int mask_length = hdr->max_length < MAX_SIGNATURE_BITS ? hdr->max_length : MAX_SIGNATURE_BITS;
+        uint64_t mask_words = (uint64_t) dict->buckets[mask_length + 1] * NUM_LETTERS;
+        if (!section_fits(hdr->masks_offset, mask_words * sizeof(uint64_t), size)) {
+            bad_image(filename, "section out of bounds");
+        }
+        dict->masks = (uint64_t *) (image + hdr->masks_offset);
+    }
+    dict->image = image;
+    dict->image_size = size;
+    return dict;
+}
+
+
+/* Write section to fp at offset, padding the file up to offset with zeros. */
+static void write_section(FILE *fp, uint64_t offset, const void *data, size_t size, char *filename) {
+    static const char zeros[8];
+    long pos = ftell(fp);
+    if (pos == -1 || (uint64_t) pos > offset
+        || fwrite(zeros, 1, offset - pos, fp) != offset - pos
+        || fwrite(data, 1, size, fp) != size) {
+        fprintf(stderr, "Could not write to %s\n", filename);
+        exit(1);
+    }
+}
+
+
+/* Compile dict into a dictionary image written to filename. The words are
+   sorted by length, keeping their order within each length. If with_masks
+   is set, the word_group mask columns are included, so programs mapping the
+   image do not have to build them.
+*/
+void write_dict_image(struct dictionary *dict, char *filename, int with_masks) {
+    struct word_index *index = build_word_index(dict);
+    int max_length = index->max_length;
+
+    // The words of each length, in dictionary order, make up that length's bucket.
+    uint32_t *buckets = malloc((max_length + 2) * sizeof(uint32_t));
+    uint32_t *offsets = malloc((dict->num_words + 1) * sizeof(uint32_t));
+    char *pool = malloc(dict->arena_size);
+    if (buckets == NULL || offsets == NULL || pool == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+    uint32_t word_num = 0;
+    size_t pool_size = 0;
+    for (int len = 0; len <= max_length; len++) {
+        struct word_group *group = &index->groups[len];
+        buckets[len] = word_num;
+        for (int i = 0; i < group->num_words; i++) {
+            offsets[word_num++] = pool_size;
+            memcpy(pool + pool_size, group->words[i], len + 1);
+            pool_size += len + 1;
+        }
+    }
+    buckets[max_length + 1] = word_num;
+    if (pool_size == 0) {
+        pool[pool_size++] = '\0';
+    }
+
+    struct dict_image_header hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, DICT_IMAGE_MAGIC, sizeof(DICT_IMAGE_MAGIC));
+    hdr.version = DICT_IMAGE_VERSION;
+    hdr.num_words = word_num;
+    hdr.max_length = max_length;
+    hdr.pool_offset = align8(sizeof(hdr));
+    hdr.pool_size = pool_size;
+    hdr.offsets_offset = align8(hdr.pool_offset + pool_size);
+    hdr.buckets_offset = align8(hdr.offsets_offset + (uint64_t) word_num * sizeof(uint32_t));
+    hdr.image_size = align8(hdr.buckets_offset + ((uint64_t) max_length + 2) * sizeof(uint32_t));
+    // Only lengths up to MAX_SIGNATURE_BITS have masks; they are the first words of the pool.
+    int mask_length = max_length < MAX_SIGNATURE_BITS ? max_length : MAX_SIGNATURE_BITS;
+    uint64_t mask_words = (uint64_t) buckets[mask_length + 1] * NUM_LETTERS;
+    if (with_masks) {
+        hdr.flags |= DICT_IMAGE_HAS_MASKS;
+        hdr.masks_offset = hdr.image_size;
+        hdr.image_size += mask_words * sizeof(uint64_t);
+    }
+
+    FILE *fp = fopen(filename, "wb");
+    if (fp == NULL) {
+        perror(filename);
+        exit(1);
+    }
+    write_section(fp, 0, &hdr, sizeof(hdr), filename);
+    write_section(fp, hdr.pool_offset, pool, pool_size, filename);
+    write_section(fp, hdr.offsets_offset, offsets, word_num * sizeof(uint32_t), filename);
+    write_section(fp, hdr.buckets_offset, buckets, (max_length + 2) * sizeof(uint32_t), filename);
+    if (with_masks) {
+        write_section(fp, hdr.masks_offset, NULL, 0, filename);
+        for (int len = 0; len <= mask_length; len++) {
+            struct word_group *group = &index->groups[len];
+            size_t column_words = (size_t) group->num_words * NUM_LETTERS;
+            if (fwrite(group->masks, sizeof(uint64_t), column_words, fp) != column_words) {
+                fprintf(stderr, "Could not write to %s\n", filename);
+                exit(1);
+            }
+        }
+    }
+    write_section(fp, hdr.image_size, NULL, 0, filename);
+    if (fclose(fp) != 0) {
+        perror("fclose");
+        exit(1);
+    }
+
+    free(buckets);
+    free(offsets);
+    free(pool);
+    deallocate_word_index(index);
+}
@@ -0,0 +1,47 @@
+#ifndef DICTIMAGE_H
+#define DICTIMAGE_H
+
+#include <stdint.h>
+
+/* A dictionary image is a binary file compiled from a text dictionary by
+   mkdict. It is mapped read-only and used in place, without parsing, so
+   every process using the same image shares one copy in the page cache.
+
+   Layout, with every section starting on an 8-byte boundary:
+     header      struct dict_image_header
+     pool        all words, each NUL-terminated, sorted by length
+     offsets     num_words uint32_t: where each word starts in the pool
+     buckets     max_length + 2 uint32_t: the words of length len are
+                 [buckets[len], buckets[len + 1])
+     masks       optional: for each length up to MAX_SIGNATURE_BITS, in
+                 order, the word_group mask columns of that length
+                 (NUM_LETTERS columns of bucket-size uint64_t)
+*/
+
+#define DICT_IMAGE_MAGIC "WORDIMG"
+#define DICT_IMAGE_VERSION 1
+
+/* Flags in the header. */
+#define DICT_IMAGE_HAS_MASKS 0x1
+
+struct dict_image_header {
+    char magic[8]; /* DICT_IMAGE_MAGIC, NUL-padded */
+    uint32_t version; /* DICT_IMAGE_VERSION */
+    uint32_t flags; /* DICT_IMAGE_ flags */
+    uint32_t num_words; /* Number of words */
+    uint32_t max_length; /* Length of the longest word */
+    uint64_t image_size; /* Size of the whole image in bytes */
+    uint64_t pool_offset; /* Start of each section, from the start of the image */
+    uint64_t pool_size;
+    uint64_t offsets_offset;
+    uint64_t buckets_offset;
+    uint64_t masks_offset; /* 0 if the image has no masks */
+};
+
+struct dictionary;
+
+int is_dict_image(int fd);
+struct dictionary *map_dict_image(int fd, char *filename);
+void write_dict_image(struct dictionary *dict, char *filename, int with_masks);
+
+#endif
@@ -0,0 +1,424 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "book.h"
+#include "family.h"
+#include "lookahead.h"
+#include "pool.h"
+#include "reading.h"
+#include "round.h"
+#include "util.h"
+#include "wordindex.h"
+
+/* This program plays evil hangman headlessly against the real engine, with
+ * scripted guessing strategies, on all cores. It reports throughput, the
+ * distribution of per-guess latency and heap allocations per game, so engine
+ * changes can be benchmarked and regressions caught.
+ *
+ *   -n games     number of games per strategy (default 10000)
+ *   -t threads   number of threads (default: one per online CPU)
+ *   -p threads   threads partitioning each game's big candidate sets
+ *                (default 1: each game thread partitions alone)
+ *   -s strategy  freq, random, greedy or all (default all)
+ *   -l length    word length of every game (default: the length of a random
+ *                dictionary word, so lengths are weighted by their word count)
+ *   -g guesses   wrong guesses allowed (default 10)
+ *   -r seed      seed of the per-thread random number generators (default 1)
+ *   -a ms        use the lookahead adversary with a budget of ms per guess
+ *                (default: keep the biggest family)
+ *   -k           keep words of up to 32 letters packed in lanes and compute
+ *                their signatures per guess, instead of using mask columns
+ *   -b book      answer the first guesses from an opening book built by mkbook
+ *   -T file      write the costs of every guess to a trace for tracesum
+ *                (default: the file named by HANGMAN_TRACE, if set)
+ *   -d file      dictionary, text or image (default dictionary.txt)
+ *
+ * The strategies guess letters in English frequency order, uniformly at
+ * random, or greedily: the letter whose biggest family is smallest.
+ *
+ * To compile the program:
+ *          make evilsim
+ */
+
+#define DEFAULT_GAMES 10000
+#define DEFAULT_GUESSES 10
+
+/* Latency histogram: 4 buckets per power of two of nanoseconds. */
+#define SUB_BUCKETS 4
+#define NUM_BUCKETS (40 * SUB_BUCKETS)
+
+enum strategy {FREQ, RANDOM, GREEDY, NUM_STRATEGIES};
+static const char *strategy_names[] = {"freq", "random", "greedy"};
+
+/* Letters by frequency in English text. */
+static const char *frequency_order = "etaoinshrdlcumwfgypbvkjxqz";
+
+
+/* Heap allocations by this thread, counted by the wrappers below, which the
+   Makefile links in place of malloc, calloc and realloc with -Wl,--wrap. */
+static __thread long thread_allocs;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t num, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size) {
+    thread_allocs++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t num, size_t size) {
+    thread_allocs++;
+    return __real_calloc(num, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+    thread_allocs++;
+    return __real_realloc(ptr, size);
+}
+
+
+/* Settings shared by all threads. */
+struct sim_config {
+    struct word_index *index;
+    struct book *book; /* Opening book, or NULL */
+    struct tracer *tracer; /* Trace of every guess, or NULL */
+    enum strategy strategy;
+    int length; /* Word length of every game, or 0 for random lengths */
+    int max_misses; /* Wrong guesses allowed */
+    long budget_ns; /* Lookahead budget per guess, or 0 to keep the biggest family */
+    long games; /* Number of games of all threads */
+    int num_threads;
+    int pool_threads; /* Partitioning threads per game thread */
+    uint64_t seed;
+};
+
+/* The work and results of one thread. */
+struct sim_thread {
+    pthread_t tid;
+    struct sim_config *config;
+    int thread_num;
+    long games; /* Games to play */
+    uint64_t rng; /* State of this thread's random number generator */
+    long wins;
+    long guesses;
+    long allocs; /* Heap allocations while playing */
+    long histogram[NUM_BUCKETS]; /* Per-guess latency */
+};
+
+
+/* Return the histogram bucket of a latency of ns nanoseconds. */
+static int latency_bucket(long ns) {
+    if (ns < SUB_BUCKETS) {
+        return ns < 0 ? 0 : ns;
+    }
+    int log = 63 - __builtin_clzl(ns);
+    int sub = (ns >> (log - 2)) & (SUB_BUCKETS - 1);
+    int bucket = (log - 1) * SUB_BUCKETS + sub;
+    return bucket < NUM_BUCKETS ? bucket : NUM_BUCKETS - 1;
+}
+
+
+/* Return the largest latency that falls in bucket. */
+static long bucket_limit(int bucket) {
+    if (bucket < SUB_BUCKETS) {
+        return bucket;
+    }
+    int log = bucket / SUB_BUCKETS + 1;
+    int sub = bucket % SUB_BUCKETS;
+    return ((long) (SUB_BUCKETS + sub + 1) << (log - 2)) - 1;
+}
+
+
+/* Return the word group of a game: the configured length, or the length
+   of a random playable word.
+*/
+static struct word_group *pick_group(struct sim_config *config, uint64_t *rng) {
+    struct word_index *index = config->index;
+    if (config->length > 0) {
+        return get_word_group(index, config->length);
+    }
+    int max_length = index->max_length < MAX_SIGNATURE_BITS ? index->max_length : MAX_SIGNATURE_BITS;
+    long playable = 0;
+    for (int len = 1; len <= max_length; len++) {
+        playable += index->groups[len].num_words;
+    }
+    long r = next_random(rng) % playable;
+    int len = 1;
+    while (r >= index->groups[len].num_words) {
+        r -= index->groups[len].num_words;
+        len++;
+    }
+    return &index->groups[len];
+}
+
+
+/* Return the next letter strategy guesses in round. */
+static char next_guess(enum strategy strategy, struct round *round, char *letters_guessed, uint64_t *rng) {
+    int c;
+    switch (strategy) {
+    case FREQ:
+        for (const char *p = frequency_order; ; p++) {
+            if (!letters_guessed[*p - 'a']) {
+                return *p;
+            }
+        }
+    case RANDOM:
+        do {
+            c = next_random(rng) % NUM_LETTERS;
+        } while (letters_guessed[c]);
+        return 'a' + c;
+    default: {
+        // Greedy: leave the fewest candidates; ties go to the earlier letter.
+        struct letter_stats stats[NUM_LETTERS];
+        get_letter_stats(round, letters_guessed, stats);
+        int best = -1;
+        for (c = 0; c < NUM_LETTERS; c++) {
+            if (!letters_guessed[c] && (best == -1 || stats[c].biggest < stats[best].biggest)) {
+                best = c;
+            }
+        }
+        return 'a' + best;
+    }
+    }
+}
+
+
+/* Play this thread's games. */
+static void *play_games(void *arg) {
+    struct sim_thread *thread = arg;
+    struct sim_config *config = thread->config;
+    struct round round;
+    struct lookahead lookahead;
+    struct pool pool;
+
+    init_round(&round, config->index);
+    set_round_book(&round, config->book);
+    set_round_tracer(&round, config->tracer);
+    if (config->pool_threads > 1) {
+        init_pool(&pool, config->pool_threads);
+        set_round_pool(&round, &pool);
+    }
+    if (config->budget_ns > 0) {
+        init_lookahead(&lookahead, config->index, config->budget_ns);
+    }
+    long allocs_before = thread_allocs;
+    for (long g = 0; g < thread->games; g++) {
+        struct word_group *group = pick_group(config, &thread->rng);
+        char letters_guessed[NUM_LETTERS] = {0};
+        int misses = 0, blanks = group->length;
+
+        start_round(&round, group);
+        while (misses < config->max_misses && blanks > 0) {
+            long start = now_ns();
+            char guess = next_guess(config->strategy, &round, letters_guessed, &thread->rng);
+            uint64_t mask;
+            if (config->budget_ns > 0) {
+                mask = choose_family(&lookahead, &round, letters_guessed, guess,
+                                     config->max_misses - misses);
+                mask = partition_round_keep(&round, guess, mask);
+            } else {
+                mask = partition_round(&round, guess);
+            }
+            thread->histogram[latency_bucket(now_ns() - start)]++;
+
+            letters_guessed[guess - 'a'] = 1;
+            thread->guesses++;
+            if (mask == 0) {
+                misses++;
+            }
+            blanks -= __builtin_popcountll(mask);
+        }
+        if (blanks == 0) {
+            thread->wins++;
+        }
+    }
+    thread->allocs = thread_allocs - allocs_before;
+    if (config->budget_ns > 0) {
+        deallocate_lookahead(&lookahead);
+    }
+    deallocate_round(&round);
+    if (config->pool_threads > 1) {
+        deallocate_pool(&pool);
+    }
+    return NULL;
+}
+
+
+/* Play config->games games on config->num_threads threads and print a report line. */
+static void simulate(struct sim_config *config) {
+    struct sim_thread *threads = calloc(config->num_threads, sizeof(struct sim_thread));
+    if (threads == NULL) {
+        perror("calloc");
+        exit(1);
+    }
+
+    long start = now_ns();
+    for (int t = 0; t < config->num_threads; t++) {
+        threads[t].config = config;
+        threads[t].thread_num = t;
+        threads[t].games = config->games / config->num_threads
+            + (t < config->games % config->num_threads);
+        threads[t].rng = config->seed * 0x100000001b3ULL + t;
+        next_random(&threads[t].rng);
+        if (pthread_create(&threads[t].tid, NULL, play_games, &threads[t]) != 0) {
+            perror("pthread_create");
+            exit(1);
+        }
+    }
+
+    long wins = 0, guesses = 0, allocs = 0;
+    long histogram[NUM_BUCKETS] = {0};
+    for (int t = 0; t < config->num_threads; t++) {
+        if (pthread_join(threads[t].tid, NULL) != 0) {
+            perror("pthread_join");
+            exit(1);
+        }
+        wins += threads[t].wins;
+        guesses += threads[t].guesses;
+        allocs += threads[t].allocs;
+        for (int b = 0; b < NUM_BUCKETS; b++) {
+            histogram[b] += threads[t].histogram[b];
+        }
+    }
+    double seconds = (now_ns() - start) / 1e9;
+
+    // Percentiles are reported as the upper limit of the bucket they fall in.
+    double percentiles[] = {0.5, 0.9, 0.99, 0.999, 1.0};
+    long limits[5];
+    long seen = 0;
+    int p = 0;
+    for (int b = 0; b < NUM_BUCKETS && p < 5; b++) {
+        seen += histogram[b];
+        while (p < 5 && histogram[b] > 0 && seen >= percentiles[p] * guesses) {
+            limits[p++] = bucket_limit(b);
+        }
+    }
+    while (p < 5) {
+        limits[p++] = 0;
+    }
+
+    printf("%-7s %9ld %6.1f%% %11.0f %9.0f %8ld %8ld %8ld %8ld %9ld %10.2f\n",
+           strategy_names[config->strategy], config->games,
+           config->games > 0 ? 100.0 * wins / config->games : 0.0,
+           guesses / seconds, config->games / seconds,
+           limits[0], limits[1], limits[2], limits[3], limits[4],
+           config->games > 0 ? (double) allocs / config->games : 0.0);
+    free(threads);
+}
+
+
+int main(int argc, char **argv) {
+    char *dict_name = DICTIONARY;
+    char *strategy_name = "all";
+    struct sim_config config;
+    char *book_name = NULL;
+    char *trace_name = getenv(TRACE_ENV);
+    int packed = 0;
+    int ch;
+
+    config.games = DEFAULT_GAMES;
+    config.num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    config.pool_threads = 1;
+    config.length = 0;
+    config.max_misses = DEFAULT_GUESSES;
+    config.seed = 1;
+    config.budget_ns = 0;
+    while ((ch = getopt(argc, argv, "n:t:p:s:l:g:r:a:kb:T:d:")) != -1) {
+        switch (ch) {
+        case 'n':
+            config.games = strtol(optarg, NULL, 10);
+            break;
+        case 't':
+            config.num_threads = strtol(optarg, NULL, 10);
+            break;
+        case 'p':
+            config.pool_threads = strtol(optarg, NULL, 10);
+            break;
+        case 's':
+            strategy_name = optarg;
+            break;
+        case 'l':
+            config.length = strtol(optarg, NULL, 10);
+            break;
+        case 'g':
+            config.max_misses = strtol(optarg, NULL, 10);
+            break;
+        case 'r':
+            config.seed = strtoull(optarg, NULL, 10);
+            break;
+        case 'a':
+            config.budget_ns = strtol(optarg, NULL, 10) * 1000000;
+            break;
+        case 'k':
+            packed = 1;
+            break;
+        case 'b':
+            book_name = optarg;
+            break;
+        case 'T':
+            trace_name = optarg;
+            break;
+        case 'd':
+            dict_name = optarg;
+            break;
+        default:
+            fprintf(stderr, "Usage: evilsim [-n games] [-t threads] [-p threads] [-s freq|random|greedy|all] "
+                    "[-l length] [-g guesses] [-r seed] [-a ms] [-k] [-b book] [-T trace] [-d dictionary]\n");
+            exit(1);
+        }
+    }
+    if (config.num_threads < 1 || config.pool_threads < 1 || config.games < 0 || config.max_misses < 1 || config.max_misses > 26
+        || config.budget_ns < 0) {
+        fprintf(stderr, "evilsim: invalid number of threads, games or guesses\n");
+        exit(1);
+    }
+
+    struct dictionary *dict = load_dictionary(dict_name);
+    config.index = packed ? build_packed_word_index(dict) : build_word_index(dict);
+    config.book = book_name != NULL ? load_book(book_name, config.index) : NULL;
+    config.tracer = trace_name != NULL && *trace_name != '\0' ? open_tracer(trace_name) : NULL;
+    if (config.length != 0) {
+        struct word_group *group = get_word_group(config.index, config.length);
+        if (group == NULL || !has_signatures(group)) {
+            fprintf(stderr, "evilsim: there are no playable words of length %d\n", config.length);
+            exit(1);
+        }
+    }
+
+    printf("%d threads x %d partitioning, %d wrong guesses allowed, %s, %s, ", config.num_threads,
+           config.pool_threads, config.max_misses,
+           config.length > 0 ? "fixed length" : "lengths weighted by word count",
+           packed ? "packed words" : "mask columns");
+    if (config.budget_ns > 0) {
+        printf("lookahead adversary, %ld ms per guess\n", config.budget_ns / 1000000);
+    } else {
+        printf("biggest-family adversary%s\n", config.book != NULL ? " with opening book" : "");
+    }
+    printf("%-7s %9s %7s %11s %9s %8s %8s %8s %8s %9s %10s\n", "", "games", "wins",
+           "guesses/s", "games/s", "p50 ns", "p90 ns", "p99 ns", "p999 ns", "max ns", "allocs/game");
+    int found = 0;
+    for (int s = 0; s < NUM_STRATEGIES; s++) {
+        if (strcmp(strategy_name, "all") == 0 || strcmp(strategy_name, strategy_names[s]) == 0) {
+            config.strategy = s;
+            simulate(&config);
+            found = 1;
+        }
+    }
+    if (!found) {
+        fprintf(stderr, "evilsim: unknown strategy %s\n", strategy_name);
+        exit(1);
+    }
+
+    if (config.book != NULL) {
+        deallocate_book(config.book);
+    }
+    if (config.tracer != NULL) {
+        close_tracer(config.tracer);
+    }
+    deallocate_word_index(config.index);
+    deallocate_dictionary(dict);
+    return 0;
+}
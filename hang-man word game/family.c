@@ -3,11 +3,12 @@
 #include <string.h>
 #include <time.h>
 #include "family.h"
+#include "wordindex.h"
 
 
-/* Number of word pointers allocated for a new family.
-   This is also the number of word pointers added to a family
-   using realloc, when the family is full.
+/* Number of families allocated for a new family list.
+   This is also the smallest number of families added to a list
+   using realloc, when the list is full.
 */
 static int family_increment = 0;
 
@@ -43,177 +44,272 @@ void print_families(Family* fam_list) {
 }
 
 
-/* Return a pointer to a new family whose signature is 
-   a copy of str. Initialize word_ptrs to point to 
-   family_increment+1 pointers, numwords to 0, 
-   maxwords to family_increment, and next to NULL.
-*/
-Family *new_family(char *str) {
-    //Initial a new family address.
-    Family *new_family;
+/* Print each family of fam_list, as print_families does. */
+void print_family_list(FamilyList *fam_list) {
+    print_families(fam_list->num_fams > 0 ? fam_list->fams : NULL);
+}
 
 
-    //Allocate the memory of new_family. And check the error of memory allocation.
-    new_family = malloc(sizeof(Family));
-    if(new_family  == NULL){
-        perror("memory allocated failed\n");
-        exit(1);
+/* Return the signature of word for letter as a bitmask:
+   bit j is set if word[j] is letter. Only the first
+   MAX_SIGNATURE_BITS characters of word are looked at.
+*/
+uint64_t get_signature_mask(char *word, char letter) {
+    uint64_t mask = 0;
+    for (int j = 0; j < MAX_SIGNATURE_BITS && word[j] != '\0'; j++) {
+        mask |= (uint64_t) (word[j] == letter) << j;
     }
+    return mask;
+}
 
-    //Allocate the memory of signature of new_family. And check the error of memory allocation.
-    new_family->signature = malloc(strlen(str) + 1);
-    if(new_family->signature ==NULL){
-        perror("memory allocated failed\n");
-        exit(1);
-    }
-    //copy str to the signature of new_family.
-    strcpy(new_family->signature, str);
 
-    //Allocate the memory of word pointers of new_family. And check the error of memory allocation.
-    new_family->word_ptrs = malloc((family_increment+1) * sizeof(char*));
-    if(new_family->word_ptrs == NULL){
-        perror("memory allocated failed\n");
-        exit(1);
-    }
-
-    // Initialize max_words, num_words, and next  of new_family.
-    new_family->max_words = family_increment;
-    new_family->num_words = 0;
-    new_family->next = NULL;
-    return new_family;
+/* Return the hash table slot to start probing at for the
+   signature with the given mask and length.
+*/
+static int signature_slot(FamilyList *fam_list, uint64_t mask, int length) {
+    uint64_t h = (mask ^ ((uint64_t) length << 58)) * 0x9e3779b97f4a7c15ULL;
+    return (int) (h >> 32) & fam_list->slot_mask;
 }
 
 
-/* Add word to the next free slot fam->word_ptrs.
-   If fam->word_ptrs is full, first use realloc to allocate family_increment
-   more pointers and then add the new pointer.
+/* Return the slot of the family whose signature has the given mask
+   and length, or the empty slot where that family belongs.
 */
-void add_word_to_family(Family *fam, char *word) {
-    //Only in the case where parameter fam is not NULL.
-    if(fam != NULL) {
-        /*
-         * When the number of words in the family reaches maximum, reallocate the memory for the new word.
-         * And check the error of memory reallocation.
-         * Increase the max_words by 1.
-         */
-        if (fam->max_words == fam->num_words) {
-            fam->word_ptrs = realloc(fam->word_ptrs, (fam->max_words + 2)* sizeof(char*));
-            if(fam->word_ptrs == NULL){
-                perror("reallocating memory of word pointers fail when adding word to family\n");
-                exit(1);
-            }
-            fam->max_words++;
+static int probe_family(FamilyList *fam_list, uint64_t mask, int length) {
+    int slot = signature_slot(fam_list, mask, length);
+    while (fam_list->slots[slot] != -1) {
+        Family *fam = &fam_list->fams[fam_list->slots[slot]];
+        if (fam->mask == mask && fam->length == length) {
+            break;
         }
-        /*
-         * Add the new word into the words pointers of the family. Increase the number of words by 1.
-         * Assign the last index of word_ptrs with NULL.
-         */
-        fam->word_ptrs[fam->num_words] = word;
-        fam->num_words++;
-        fam->word_ptrs[fam->num_words] = NULL;
+        slot = (slot + 1) & fam_list->slot_mask;
     }
-
+    return slot;
 }
 
 
 /* Return a pointer to the family whose signature is sig;
    if there is no such family, return NULL.
-   fam_list is a pointer to the head of a list of Family nodes.
+   fam_list is a pointer to a list of families.
+   No family has a signature longer than MAX_SIGNATURE_BITS.
 */
-Family *find_family(Family *fam_list, char *sig) {
-    // Initialize a cursor in the family list
-    Family *cur = fam_list;
-    // loop through each node in the family until find the family with the signature to be found.
-    while(cur != NULL && strcmp(cur -> signature, sig) != 0 ){
-        cur = cur -> next;
+Family *find_family(FamilyList *fam_list, char *sig) {
+    // Any character but '-' in a signature is the letter the list was partitioned by.
+    uint64_t mask = 0;
+    int length;
+    for (length = 0; sig[length] != '\0'; length++) {
+        if (length == MAX_SIGNATURE_BITS) {
+            return NULL;
+        }
+        mask |= (uint64_t) (sig[length] != '-') << length;
     }
-    return cur;
+    int slot = probe_family(fam_list, mask, length);
+    if (fam_list->slots[slot] == -1) {
+        return NULL;
+    }
+    return &fam_list->fams[fam_list->slots[slot]];
 }
 
 
 /* Return a pointer to the family in the list with the most words;
    if the list is empty, return NULL. If multiple families have the most words,
-   return a pointer to any of them.
-   fam_list is a pointer to the head of a list of Family nodes.
+   return a pointer to the first one to reach that size.
+   The biggest family is found while the list is generated.
 */
-Family *find_biggest_family(Family *fam_list) {
-    /*
-     * Copy the address of the head of family list into a new variable cur.
-     * Initial max_words representing the maximum number of the words among all families.
-     * Initial an address of a family to return.
-     */
-    Family *cur = fam_list;
-    int max_words = 0;
-    Family *ret_family = NULL;
-
-    // loop through each family in the list. Find the family with most words.
-    while(cur != NULL){
-        if(cur->max_words > max_words){
-            max_words = cur->max_words;
-            ret_family = cur;
-        }
-        cur = cur -> next;
-    }
-    return ret_family;
+Family *find_biggest_family(FamilyList *fam_list) {
+    return fam_list->biggest;
 }
 
 
-/* Deallocate all memory rooted in the List pointed to by fam_list. */
-void deallocate_families(Family *fam_list) {
-    //Initialize an address of family.
-    Family *current;
-    //loop through each family in the list
-    while(fam_list != NULL){
-        // free signature and word_ptrs
-        free(fam_list->signature);
-        free(fam_list->word_ptrs);
-        // record the address of current family and move to next family. Then free the current family.
-        current = fam_list;
-        fam_list = fam_list->next;
-        free(current);
+/* Deallocate all memory rooted in the list pointed to by fam_list. */
+void deallocate_families(FamilyList *fam_list) {
+    if(fam_list == NULL){
+        return;
     }
+    // free the signatures, then the storage shared by all families.
+    for(int i = 0; i < fam_list->num_fams; i++){
+        free(fam_list->fams[i].signature);
+    }
+    free(fam_list->word_block);
+    free(fam_list->id_block);
+    free(fam_list->slots);
+    free(fam_list->fams);
+    free(fam_list);
 }
 
 
-/* Generate and return a linked list of all families using words pointed to
-   by word_list, using letter to partition the words.
+/* Partition num_words words into families and return the list.
+   Word i has signature mask masks[i] and length lengths[i], or length if
+   lengths is NULL. Its text is words[i], or words[ids[i]] if ids is not NULL;
+   in that case ids[i] is also recorded in the family's word_ids.
 
-   Implementation tips: To decide the family in which each word belongs, you
-   will need to generate the signature of each word. Create only the families
-   that have at least one word from the current word_list.
+   Each signature is looked up in an open-addressing hash table, so each word
+   costs O(1) regardless of how many families there are. A first pass counts
+   the words of each family and tracks the biggest one; a second pass places
+   the words, so every family's word_ptrs is a slice of one allocation.
 */
-Family *generate_families(char **word_list, char letter) {
-    //Initial the head of the family list and a cursor in the family list.
-    Family *head = NULL;
-    Family *cur;
-    //loop through each word in the dictionary
-    for(int i = 0; word_list[i] != NULL; i++){
-        //Find the signature of the word
-        char *curr_word = word_list[i];
-        char signature[1 + strlen(curr_word)];
-        for(int j = 0; j != strlen(curr_word); j++){
-            if(curr_word[j] == letter){
-                signature[j] = letter;
-            }else{
-                signature[j] = '-';
+static FamilyList *partition_words(int num_words, char **words, int *ids,
+                                   uint64_t *masks, int *lengths, int length, char letter) {
+    // Size the hash table so it never fills beyond half.
+    int num_slots = 16;
+    while(num_slots < 2 * num_words){
+        num_slots *= 2;
+    }
+
+    FamilyList *fam_list = malloc(sizeof(FamilyList));
+    // fam_of_word[i] is the index of the family of word i.
+    int *fam_of_word = malloc((num_words + 1) * sizeof(int));
+    if(fam_list == NULL || fam_of_word == NULL){
+        perror("memory allocated failed\n");
+        exit(1);
+    }
+    fam_list->max_fams = family_increment > 0 ? family_increment : 16;
+    fam_list->num_fams = 0;
+    fam_list->biggest = NULL;
+    fam_list->slot_mask = num_slots - 1;
+    fam_list->fams = malloc(fam_list->max_fams * sizeof(Family));
+    fam_list->slots = malloc(num_slots * sizeof(int));
+    if(fam_list->fams == NULL || fam_list->slots == NULL){
+        perror("memory allocated failed\n");
+        exit(1);
+    }
+    memset(fam_list->slots, -1, num_slots * sizeof(int));
+
+    int biggest_index = -1, biggest_words = 0;
+    // First pass: find each word's family, creating families as they appear, and count words.
+    for(int i = 0; i < num_words; i++){
+        int word_length = lengths != NULL ? lengths[i] : length;
+        int slot = probe_family(fam_list, masks[i], word_length);
+        if(fam_list->slots[slot] == -1){
+            // Grow the family array when it is full.
+            if(fam_list->num_fams == fam_list->max_fams){
+                fam_list->max_fams *= 2;
+                fam_list->fams = realloc(fam_list->fams, fam_list->max_fams * sizeof(Family));
+                if(fam_list->fams == NULL){
+                    perror("reallocating memory of families fail\n");
+                    exit(1);
+                }
             }
+            Family *fam = &fam_list->fams[fam_list->num_fams];
+            fam->mask = masks[i];
+            fam->length = word_length;
+            fam->num_words = 0;
+            fam_list->slots[slot] = fam_list->num_fams++;
         }
-        signature[strlen(curr_word)] = '\0';
-
-        //let cursor point to the family with the signature same as the word.
-        cur = find_family(head, signature);
-        /* if the family matching the signature can not be found, then create a new family with
-         * the signature.Let the new family be the cursor and the head of the family list.
-         */
-        if(cur == NULL){
-            cur = new_family(signature);
-            cur->next = head;
-            head = cur;
+        int fam_index = fam_list->slots[slot];
+        fam_of_word[i] = fam_index;
+        // Track the biggest family as the counts grow; ties go to the family that got there first.
+        if(++fam_list->fams[fam_index].num_words > biggest_words){
+            biggest_words = fam_list->fams[fam_index].num_words;
+            biggest_index = fam_index;
         }
-        // add word to the family the cursor pointing to.
-        add_word_to_family(cur, curr_word);
     }
-    return head;
+    if(biggest_index != -1){
+        fam_list->biggest = &fam_list->fams[biggest_index];
+    }
+
+    // Give each family its slice of word_block, with room for the final NULL, and its signature.
+    fam_list->word_block = malloc((num_words + fam_list->num_fams) * sizeof(char *));
+    fam_list->id_block = NULL;
+    if(ids != NULL){
+        fam_list->id_block = malloc((num_words + 1) * sizeof(int));
+    }
+    if(fam_list->word_block == NULL || (ids != NULL && fam_list->id_block == NULL)){
+        perror("memory allocated failed\n");
+        exit(1);
+    }
+    char **next_slice = fam_list->word_block;
+    int *next_ids = fam_list->id_block;
+    for(int f = 0; f < fam_list->num_fams; f++){
+        Family *fam = &fam_list->fams[f];
+        fam->next = f + 1 < fam_list->num_fams ? fam + 1 : NULL;
+        fam->word_ptrs = next_slice;
+        fam->max_words = fam->num_words;
+        next_slice += fam->num_words + 1;
+        fam->word_ptrs[fam->num_words] = NULL;
+        fam->word_ids = next_ids;
+        if(next_ids != NULL){
+            next_ids += fam->num_words;
+        }
+
+        fam->signature = malloc(fam->length + 1);
+        if(fam->signature == NULL){
+            perror("memory allocated failed\n");
+            exit(1);
+        }
+        for(int j = 0; j < fam->length; j++){
+            fam->signature[j] = (fam->mask >> j) & 1 ? letter : '-';
+        }
+        fam->signature[fam->length] = '\0';
+        // num_words counts up again as the second pass places the words.
+        fam->num_words = 0;
+    }
+
+    // Second pass: place every word in its family.
+    for(int i = 0; i < num_words; i++){
+        Family *fam = &fam_list->fams[fam_of_word[i]];
+        if(ids != NULL){
+            fam->word_ids[fam->num_words] = ids[i];
+            fam->word_ptrs[fam->num_words++] = words[ids[i]];
+        }else{
+            fam->word_ptrs[fam->num_words++] = words[i];
+        }
+    }
+    free(fam_of_word);
+    return fam_list;
+}
+
+
+/* Generate and return a list of all families using words pointed to
+   by word_list, using letter to partition the words.
+   A signature bitmask only describes MAX_SIGNATURE_BITS positions, so
+   if a word is longer than that, return NULL instead.
+*/
+FamilyList *generate_families(char **word_list, char letter) {
+    int num_words = 0;
+    while(word_list[num_words] != NULL){
+        num_words++;
+    }
+    uint64_t *masks = malloc((num_words + 1) * sizeof(uint64_t));
+    int *lengths = malloc((num_words + 1) * sizeof(int));
+    if(masks == NULL || lengths == NULL){
+        perror("memory allocated failed\n");
+        exit(1);
+    }
+    for(int i = 0; i < num_words; i++){
+        lengths[i] = strlen(word_list[i]);
+        if(lengths[i] > MAX_SIGNATURE_BITS){
+            free(masks);
+            free(lengths);
+            return NULL;
+        }
+        masks[i] = get_signature_mask(word_list[i], letter);
+    }
+    FamilyList *fam_list = partition_words(num_words, word_list, NULL, masks, lengths, 0, letter);
+    free(masks);
+    free(lengths);
+    return fam_list;
+}
+
+
+/* Generate and return a list of all families of the num_ids words of group
+   whose indexes are in ids, using letter to partition the words.
+   The signatures are read from the group's mask column for letter instead of
+   being computed from the words, and each family records its words' indexes.
+*/
+FamilyList *generate_families_indexed(struct word_group *group, int *ids, int num_ids, char letter) {
+    uint64_t *column = get_letter_column(group, letter);
+    uint64_t *masks = malloc((num_ids + 1) * sizeof(uint64_t));
+    if(masks == NULL){
+        perror("memory allocated failed\n");
+        exit(1);
+    }
+    for(int i = 0; i < num_ids; i++){
+        masks[i] = column[ids[i]];
+    }
+    FamilyList *fam_list = partition_words(num_ids, group->words, ids, masks, NULL, group->length, letter);
+    free(masks);
+    return fam_list;
 }
 
 
@@ -226,7 +322,7 @@ char *get_family_signature(Family *fam) {
 /* Return a pointer to word pointers, each of which
    points to a word in fam. These pointers should not be the same
    as those used by fam->word_ptrs (i.e. they should be independently malloc'd),
-   because fam->word_ptrs can move during a realloc.
+   because fam->word_ptrs is freed together with its family list.
    As with fam->word_ptrs, the final pointer should be NULL.
 */
 char **get_new_word_list(Family *fam) {
@@ -251,6 +347,20 @@ char **get_new_word_list(Family *fam) {
 }
 
 
+/* Return a newly allocated copy of the word indexes of fam, which must come
+   from generate_families_indexed.
+*/
+int *get_new_word_ids(Family *fam) {
+    int *new_ids = malloc((fam->num_words + 1) * sizeof(int));
+    if(new_ids == NULL){
+        perror("new word ids memory allocation fails\n");
+        exit(1);
+    }
+    memcpy(new_ids, fam->word_ids, fam->num_words * sizeof(int));
+    return new_ids;
+}
+
+
 /* Return a pointer to a random word from fam. 
    Use rand (man 3 rand) to generate random integers.
 */
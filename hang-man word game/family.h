@@ -1,26 +1,58 @@
 #ifndef FAMILY_H
 #define FAMILY_H
 
+#include <stdint.h>
+
+/* Longest word a signature bitmask can describe. generate_families
+   returns NULL for a word list with a longer word, and find_family
+   finds no family with a longer signature.
+*/
+#define MAX_SIGNATURE_BITS 64
+
 struct fam {
     char *signature; /* Family signature; e.g. ---e */
+    uint64_t mask; /* Signature as a bitmask; bit j is set if position j holds the letter */
+    int length; /* Length of the signature */
     char **word_ptrs; /* Words belonging to family */
+    int *word_ids; /* Indexes of the words in their word_group, or NULL */
     int num_words; /* Number of words in family */
     int max_words; /* Number of total pointers in word_ptrs so far */
-    struct fam *next; /* NULL means end of list */
+    struct fam *next; /* The next family of its list; NULL means end of list */
 };
-typedef struct fam Family; 
+typedef struct fam Family;
+
+/* All families of one partition of a word list, stored contiguously. */
+struct fam_list {
+    Family *fams; /* The families, in order of first appearance, also linked by next */
+    int num_fams; /* Number of families in fams */
+    int max_fams; /* Number of families fams has room for */
+    Family *biggest; /* The family with the most words, NULL if there are none */
+    int *slots; /* Open-addressing hash table of indexes into fams; -1 is empty */
+    int slot_mask; /* Number of slots minus one; the number of slots is a power of two */
+    char **word_block; /* Storage shared by the word_ptrs of all families */
+    int *id_block; /* Storage shared by the word_ids of all families, or NULL */
+};
+typedef struct fam_list FamilyList;
+
+struct word_group;
 
 
+/* Games are played with round.c, and wheel only calls init_family here.
+   The rest is kept on purpose: it is the original partitioning, which
+   partition_round must agree with family for family.
+*/
 void init_family(int size);
 void print_families(Family* fam_list);
-Family *new_family(char *str);
-void add_word_to_family(Family *fam, char *word);
-Family *find_family(Family *fam_list, char *sig);
-Family *find_biggest_family(Family *fam_list);
-void deallocate_families(Family *fam_list);
-Family *generate_families(char **word_list, char letter);
+void print_family_list(FamilyList *fam_list);
+uint64_t get_signature_mask(char *word, char letter);
+Family *find_family(FamilyList *fam_list, char *sig);
+Family *find_biggest_family(FamilyList *fam_list);
+void deallocate_families(FamilyList *fam_list);
+FamilyList *generate_families(char **word_list, char letter);
+FamilyList *generate_families_indexed(struct word_group *group, int *ids, int num_ids, char letter);
 char *get_family_signature(Family *fam);
 char **get_new_word_list(Family *fam);
+int *get_new_word_ids(Family *fam);
 char *get_random_word_from_family(Family *fam);
 
 #endif
@@ -0,0 +1,257 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <malloc.h>
+#include "candset.h"
+#include "reading.h"
+#include "round.h"
+#include "util.h"
+#include "wordindex.h"
+
+/* This program hosts many evil hangman games at once on one thread, as a
+ * server would, and plays them in turn one guess at a time with random
+ * guessers. It compares the memory per game and the guess throughput of
+ * rounds (candidate index arrays) and candidate bitsets.
+ *
+ *   -n games     number of concurrent games (default 1000)
+ *   -e engine    round, bits or both (default both); with both, every game
+ *                is played by each engine and the results must agree
+ *   -l length    word length of every game (default: the length of a random
+ *                dictionary word, so lengths are weighted by their word count)
+ *   -g guesses   wrong guesses allowed (default 10)
+ *   -r seed      seed of the guessers' random number generators (default 1)
+ *   -d file      dictionary, text or image (default dictionary.txt)
+ *
+ * To compile the program:
+ *          make gamesbench
+ */
+
+#define DEFAULT_GAMES 1000
+#define DEFAULT_GUESSES 10
+
+enum engine {ROUND, BITS};
+static const char *engine_names[] = {"round", "bits"};
+
+/* One game being hosted. */
+struct game {
+    struct round round; /* The candidates, for the round engine */
+    struct candset set; /* The candidates, for the bits engine */
+    uint64_t rng; /* State of the guesser's random number generator */
+    char letters_guessed[NUM_LETTERS];
+    int length; /* Word length */
+    int misses;
+    int blanks; /* Letters not yet revealed */
+    uint64_t outcome; /* Hash of the masks the adversary answered with */
+};
+
+
+/* Return the number of bytes of heap in use. */
+static size_t heap_in_use(void) {
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+}
+
+
+/* Return the word length of a game: length, or the length of a random
+   playable word of bits.
+*/
+static int pick_length(struct bit_index *bits, int length, uint64_t *rng) {
+    if (length > 0) {
+        return length;
+    }
+    long playable = 0;
+    for (int len = 1; len <= bits->max_length; len++) {
+        if (bits->groups[len].positions != NULL) {
+            playable += bits->groups[len].words->num_words;
+        }
+    }
+    long r = next_random(rng) % playable;
+    int len = 1;
+    while (bits->groups[len].positions == NULL || r >= bits->groups[len].words->num_words) {
+        if (bits->groups[len].positions != NULL) {
+            r -= bits->groups[len].words->num_words;
+        }
+        len++;
+    }
+    return len;
+}
+
+
+/* Host num_games games of the given lengths with engine, playing one guess
+   of each in turn until all are over, and print a report line. The games'
+   outcomes are left in games.
+*/
+static void host_games(enum engine engine, struct word_index *index, struct bit_index *bits,
+                       struct game *games, int num_games, int max_misses, uint64_t seed) {
+    struct candset_scratch scratch;
+    size_t heap_before = heap_in_use();
+    long start = now_ns();
+    for (int g = 0; g < num_games; g++) {
+        struct game *game = &games[g];
+        if (engine == ROUND) {
+            init_round(&game->round, index);
+            start_round(&game->round, get_word_group(index, game->length));
+        } else {
+            init_candset(&game->set, bits);
+            start_candset(&game->set, get_bit_group(bits, game->length));
+        }
+        game->rng = seed * 0x100000001b3ULL + g;
+        memset(game->letters_guessed, 0, NUM_LETTERS);
+        game->misses = 0;
+        game->blanks = game->length;
+        game->outcome = 0;
+    }
+    if (engine == BITS) {
+        init_candset_scratch(&scratch, bits);
+    }
+    size_t heap_bytes = heap_in_use() - heap_before;
+    long setup_ns = now_ns() - start;
+
+    start = now_ns();
+    long guesses = 0, wins = 0;
+    for (int live = num_games; live > 0; ) {
+        live = 0;
+        for (int g = 0; g < num_games; g++) {
+            struct game *game = &games[g];
+            if (game->misses == max_misses || game->blanks == 0) {
+                continue;
+            }
+            int c;
+            do {
+                c = next_random(&game->rng) % NUM_LETTERS;
+            } while (game->letters_guessed[c]);
+            game->letters_guessed[c] = 1;
+
+            uint64_t mask;
+            if (engine == ROUND) {
+                mask = partition_round(&game->round, 'a' + c);
+            } else {
+                mask = partition_candset(&game->set, 'a' + c, &scratch);
+            }
+            guesses++;
+            game->outcome = (game->outcome ^ mask) * 0x100000001b3ULL;
+            if (mask == 0) {
+                game->misses++;
+            }
+            game->blanks -= __builtin_popcountll(mask);
+            if (game->blanks == 0) {
+                wins++;
+            }
+            if (game->misses < max_misses && game->blanks > 0) {
+                live++;
+            }
+        }
+    }
+    double seconds = (now_ns() - start) / 1e9;
+
+    printf("%-6s %8d %6.1f%% %12.0f %10.1f %11.0f\n", engine_names[engine], num_games,
+           num_games > 0 ? 100.0 * wins / num_games : 0.0,
+           num_games > 0 ? (double) heap_bytes / num_games : 0.0,
+           setup_ns / 1e6, guesses / seconds);
+
+    for (int g = 0; g < num_games; g++) {
+        if (engine == ROUND) {
+            deallocate_round(&games[g].round);
+        } else {
+            deallocate_candset(&games[g].set);
+        }
+    }
+    if (engine == BITS) {
+        deallocate_candset_scratch(&scratch);
+    }
+}
+
+
+int main(int argc, char **argv) {
+    char *dict_name = DICTIONARY;
+    char *engine_name = "both";
+    int num_games = DEFAULT_GAMES, length = 0, max_misses = DEFAULT_GUESSES;
+    uint64_t seed = 1;
+    int ch;
+
+    while ((ch = getopt(argc, argv, "n:e:l:g:r:d:")) != -1) {
+        switch (ch) {
+        case 'n':
+            num_games = strtol(optarg, NULL, 10);
+            break;
+        case 'e':
+            engine_name = optarg;
+            break;
+        case 'l':
+            length = strtol(optarg, NULL, 10);
+            break;
+        case 'g':
+            max_misses = strtol(optarg, NULL, 10);
+            break;
+        case 'r':
+            seed = strtoull(optarg, NULL, 10);
+            break;
+        case 'd':
+            dict_name = optarg;
+            break;
+        default:
+            fprintf(stderr, "Usage: gamesbench [-n games] [-e round|bits|both] [-l length] "
+                    "[-g guesses] [-r seed] [-d dictionary]\n");
+            exit(1);
+        }
+    }
+    int both = strcmp(engine_name, "both") == 0;
+    if (!both && strcmp(engine_name, "round") != 0 && strcmp(engine_name, "bits") != 0) {
+        fprintf(stderr, "gamesbench: unknown engine %s\n", engine_name);
+        exit(1);
+    }
+    if (num_games < 1 || max_misses < 1 || max_misses > 26) {
+        fprintf(stderr, "gamesbench: invalid number of games or guesses\n");
+        exit(1);
+    }
+
+    struct dictionary *dict = load_dictionary(dict_name);
+    struct word_index *index = build_word_index(dict);
+    struct bit_index *bits = build_bit_index(index);
+    if (length != 0 && get_bit_group(bits, length) == NULL) {
+        fprintf(stderr, "gamesbench: there are no playable words of length %d\n", length);
+        exit(1);
+    }
+
+    struct game *games = calloc(num_games, sizeof(struct game));
+    uint64_t *outcomes = malloc(num_games * sizeof(uint64_t));
+    if (games == NULL || outcomes == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+    uint64_t rng = seed;
+    for (int g = 0; g < num_games; g++) {
+        games[g].length = pick_length(bits, length, &rng);
+    }
+
+    printf("%d wrong guesses allowed, %s\n", max_misses,
+           length > 0 ? "fixed length" : "lengths weighted by word count");
+    printf("%-6s %8s %7s %12s %10s %11s\n", "", "games", "wins", "heap/game", "setup ms", "guesses/s");
+    if (both || strcmp(engine_name, "round") == 0) {
+        host_games(ROUND, index, bits, games, num_games, max_misses, seed);
+        for (int g = 0; g < num_games; g++) {
+            outcomes[g] = games[g].outcome;
+        }
+    }
+    if (both || strcmp(engine_name, "bits") == 0) {
+        host_games(BITS, index, bits, games, num_games, max_misses, seed);
+    }
+    if (both) {
+        int differ = 0;
+        for (int g = 0; g < num_games; g++) {
+            differ += outcomes[g] != games[g].outcome;
+        }
+        if (differ > 0) {
+            fprintf(stderr, "gamesbench: %d games played differently by the two engines\n", differ);
+            exit(1);
+        }
+    }
+
+    free(outcomes);
+    free(games);
+    deallocate_bit_index(bits);
+    deallocate_word_index(index);
+    deallocate_dictionary(dict);
+    return 0;
+}
@@ -0,0 +1,270 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lookahead.h"
+#include "util.h"
+#include "wordindex.h"
+
+/* Kinds of transposition table values. */
+#define EXACT 0
+#define LOWER 1 /* The value is at least this */
+#define UPPER 2 /* The value is at most this */
+
+/* Letters by frequency in English text: the order the guesser's letters are
+   tried in, so good guesses come first and cut the search sooner. */
+static const char *guess_order = "etaoinshrdlcumwfgypbvkjxqz";
+
+
+/* Allocate everything la needs to search games over any group of index,
+   with budget_ns nanoseconds per choice.
+*/
+void init_lookahead(struct lookahead *la, struct word_index *index, long budget_ns) {
+    int max_ids = 1;
+    for (int len = 0; len <= index->max_length; len++) {
+        if (index->groups[len].num_words > max_ids) {
+            max_ids = index->groups[len].num_words;
+        }
+    }
+    la->budget_ns = budget_ns;
+    la->ids = malloc(max_ids * sizeof(int));
+    la->spare = malloc(max_ids * sizeof(int));
+    la->keys = malloc(max_ids * sizeof(uint64_t));
+    la->column = malloc(max_ids * sizeof(uint64_t));
+    la->table = calloc((size_t) 1 << TABLE_BITS, sizeof(struct tt_entry));
+    if (la->ids == NULL || la->spare == NULL || la->keys == NULL || la->column == NULL
+        || la->table == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+    // The set of candidates is keyed by the XOR of its words' keys (Zobrist hashing).
+    for (int i = 0; i < max_ids; i++) {
+        la->keys[i] = mix64(i);
+    }
+    // Each guess of the search holds one partition, plus the one at the root.
+    init_arena(&la->arena, (MAX_LOOKAHEAD + 2) * partition_scratch_size(max_ids));
+    la->group = NULL;
+    la->nodes = 0;
+    la->depth = 0;
+}
+
+
+/* Return the table key of the guesser's position: the candidates with key
+   set_key, the letters guessed, the misses left and the search depth.
+*/
+static uint64_t position_key(struct lookahead *la, uint64_t set_key, uint32_t guessed,
+                             int misses_left, int depth) {
+    uint64_t state = guessed | (uint64_t) misses_left << 26 | (uint64_t) depth << 34
+        | (uint64_t) la->group->length << 42;
+    uint64_t key = set_key ^ mix64(state);
+    return key != 0 ? key : 1;
+}
+
+
+static int guesser_value(struct lookahead *la, int first, int n, uint64_t set_key, uint32_t guessed,
+                         int misses_left, int depth, int alpha, int beta);
+
+
+/* Return the most misses the adversary can force when the guesser, with the
+   candidates ids[first], ..., ids[first + n - 1], guesses letter c and then
+   depth - 1 more letters. The value is at most misses_left. Values are only
+   exact within (alpha, beta); outside, they are bounds on the side of the
+   window they fall on.
+
+   Return -1 if c does not split the candidates: the guess then either
+   certainly misses or reveals nothing, and the guesser never needs it.
+*/
+static int adversary_value(struct lookahead *la, int c, int first, int n, uint32_t guessed,
+                           int misses_left, int depth, int alpha, int beta) {
+    // Partitioning is the expensive step, so the deadline is checked before each one.
+    if (now_ns() > la->deadline) {
+        la->timed_out = 1;
+        return 0;
+    }
+    struct partition part;
+    size_t mark = la->arena.used;
+    uint64_t *column = get_candidate_column(la->group, 'a' + c, la->ids + first, n, la->column);
+    partition_range(&la->arena, column, la->ids, la->spare, first, n, la->keys, &part);
+    if (part.num_fams == 1) {
+        la->arena.used = mark;
+        return -1;
+    }
+
+    int best = 0;
+    for (int f = 0; f < part.num_fams; f++) {
+        int miss = part.masks[f] == 0;
+        int value = 1;
+        if (!miss || misses_left > 1) {
+            value = miss + guesser_value(la, part.starts[f], part.counts[f], part.hashes[f],
+                                         guessed | (uint32_t) 1 << c, misses_left - miss,
+                                         depth - 1, alpha - miss, beta - miss);
+        }
+        if (la->timed_out) {
+            break;
+        }
+        if (value > best) {
+            best = value;
+        }
+        if (best >= beta || best == misses_left) {
+            break;
+        }
+    }
+    la->arena.used = mark;
+    return best;
+}
+
+
+/* Return the most misses the adversary can force in the next depth guesses
+   of a guesser playing as well as possible with the candidates
+   ids[first], ..., ids[first + n - 1], whose keys XOR to set_key.
+   The window (alpha, beta) is as for adversary_value.
+*/
+static int guesser_value(struct lookahead *la, int first, int n, uint64_t set_key, uint32_t guessed,
+                         int misses_left, int depth, int alpha, int beta) {
+    // With one candidate left the guesser knows the word.
+    if (n <= 1) {
+        return 0;
+    }
+    if (depth == 0) {
+        la->hit_depth = 1;
+        return 0;
+    }
+    la->nodes++;
+
+    uint64_t key = position_key(la, set_key, guessed, misses_left, depth);
+    struct tt_entry *entry = &la->table[key & (((uint64_t) 1 << TABLE_BITS) - 1)];
+    if (entry->key == key) {
+        if (entry->bound == EXACT
+            || (entry->bound == LOWER && entry->value >= beta)
+            || (entry->bound == UPPER && entry->value <= alpha)) {
+            la->hit_depth |= entry->hit_depth;
+            return entry->value;
+        }
+    }
+    int hit_depth = la->hit_depth;
+    la->hit_depth = 0;
+
+    // The guesser minimizes: start above any value and keep the best letter.
+    int best = misses_left + 1;
+    for (const char *p = guess_order; *p != '\0' && best > 0 && best > alpha; p++) {
+        int c = *p - 'a';
+        if (guessed & ((uint32_t) 1 << c)) {
+            continue;
+        }
+        int value = adversary_value(la, c, first, n, guessed, misses_left, depth, alpha,
+                                    best < beta ? best : beta);
+        if (la->timed_out) {
+            return 0;
+        }
+        if (value >= 0 && value < best) {
+            best = value;
+        }
+    }
+    // No letter splits the candidates, so none can cost the guesser anything.
+    if (best > misses_left) {
+        best = 0;
+    }
+
+    entry->key = key;
+    entry->value = best;
+    entry->bound = best <= alpha ? UPPER : best >= beta ? LOWER : EXACT;
+    entry->hit_depth = la->hit_depth;
+    la->hit_depth |= hit_depth;
+    return best;
+}
+
+
+/* Charge a choice that started at start to the lookahead phase of round's
+   guess, if it is traced, and return mask.
+*/
+static uint64_t end_choice(struct lookahead *la, struct round *round, long start, uint64_t mask) {
+    if (round->tracer != NULL) {
+        end_round_phase(round, PHASE_LOOKAHEAD, start, 0);
+        round->trace.lookahead_nodes += la->nodes;
+    }
+    return mask;
+}
+
+
+/* Return the signature mask of the family of round's candidates the
+   adversary keeps when the guesser guesses letter with misses_left wrong
+   guesses to go; letters_guessed[c] is nonzero for every letter guessed
+   before. The round is not changed; pass the mask to partition_round_keep.
+
+   A family is worth the miss it costs now, if it is the family without the
+   letter, plus the misses the adversary can force afterwards. The search
+   looks one more guess ahead each time until the budget runs out or a
+   deeper search cannot change the outcome. Ties go to the bigger family.
+*/
+uint64_t choose_family(struct lookahead *la, struct round *round, char *letters_guessed,
+                       char letter, int misses_left) {
+    materialize_round(round);
+    long start = begin_round_phase(round);
+    int first = round->first, n = round->num_ids;
+    uint32_t guessed = (uint32_t) 1 << (letter - 'a');
+    for (int c = 0; c < NUM_LETTERS; c++) {
+        if (letters_guessed[c]) {
+            guessed |= (uint32_t) 1 << c;
+        }
+    }
+
+    la->group = round->group;
+    la->deadline = now_ns() + la->budget_ns;
+    la->timed_out = 0;
+    la->nodes = 0;
+    la->depth = 0;
+    memcpy(la->ids + first, round->ids + first, n * sizeof(int));
+    reset_arena(&la->arena);
+    struct partition root;
+    uint64_t *column = get_candidate_column(la->group, letter, la->ids + first, n, la->column);
+    partition_range(&la->arena, column, la->ids, la->spare, first, n, la->keys, &root);
+
+    // Without looking ahead, prefer a miss, then size.
+    int chosen = root.biggest;
+    for (int f = 0; f < root.num_fams; f++) {
+        if (root.masks[f] == 0) {
+            chosen = f;
+        }
+    }
+    if (root.num_fams == 1 || misses_left <= 1) {
+        return end_choice(la, round, start, root.masks[chosen]);
+    }
+
+    for (int depth = 1; depth <= MAX_LOOKAHEAD; depth++) {
+        int best = -1, best_f = -1;
+        la->hit_depth = 0;
+        for (int f = 0; f < root.num_fams; f++) {
+            int miss = root.masks[f] == 0;
+            // Only a value of at least best matters; the window cuts anything lower.
+            int value = miss + guesser_value(la, root.starts[f], root.counts[f], root.hashes[f],
+                                             guessed, misses_left - miss, depth,
+                                             best - miss - 1, misses_left + 1);
+            if (la->timed_out) {
+                break;
+            }
+            if (value > best || (value == best && root.counts[f] > root.counts[best_f])) {
+                best = value;
+                best_f = f;
+            }
+        }
+        if (la->timed_out) {
+            break;
+        }
+        chosen = best_f;
+        la->depth = depth;
+        if (!la->hit_depth || best >= misses_left) {
+            break;
+        }
+    }
+    return end_choice(la, round, start, root.masks[chosen]);
+}
+
+
+/* Deallocate all memory acquired by init_lookahead. */
+void deallocate_lookahead(struct lookahead *la) {
+    free(la->ids);
+    free(la->spare);
+    free(la->keys);
+    free(la->column);
+    free(la->table);
+    free_arena(&la->arena);
+}
@@ -0,0 +1,50 @@
+#ifndef LOOKAHEAD_H
+#define LOOKAHEAD_H
+
+#include <stdint.h>
+#include "round.h"
+
+/* Most guesses ahead choose_family searches. */
+#define MAX_LOOKAHEAD 8
+
+/* The transposition table has 2^TABLE_BITS entries. */
+#define TABLE_BITS 17
+
+/* A searched position: the value found and whether it is exact or a bound. */
+struct tt_entry {
+    uint64_t key; /* Key of the position; 0 if the entry is empty */
+    int value; /* Misses the adversary can force */
+    short bound; /* EXACT, LOWER or UPPER; see lookahead.c */
+    short hit_depth; /* 1 if the search below was cut short by its depth */
+};
+
+/* A lookahead adversary: instead of keeping the biggest family, it keeps the
+   family that lets it force the most misses on the guesser in the next few
+   guesses, found by minimax search with a transposition table and
+   alpha-beta cutoffs. The search deepens one guess at a time until the
+   time budget runs out; the deepest finished search decides.
+
+   All memory is allocated by init_lookahead.
+*/
+struct lookahead {
+    long budget_ns; /* Time choose_family may take */
+    struct arena arena; /* Partitions of the positions being searched */
+    int *ids; /* Copy of the candidates, partitioned during the search */
+    int *spare; /* Scratch space for partitioning ids */
+    uint64_t *column; /* Signatures of a range of ids, for groups without mask columns */
+    uint64_t *keys; /* Random key of each word index in a group */
+    struct tt_entry *table; /* Transposition table */
+    struct word_group *group; /* The words of the position being searched */
+    long deadline; /* Time at which the search stops */
+    int timed_out; /* 1 if the deadline passed during the search */
+    int hit_depth; /* 1 if some line was cut short by the depth limit */
+    long nodes; /* Guesser positions visited by the last choice */
+    int depth; /* Depth of the search that made the last choice */
+};
+
+void init_lookahead(struct lookahead *la, struct word_index *index, long budget_ns);
+uint64_t choose_family(struct lookahead *la, struct round *round, char *letters_guessed,
+                       char letter, int misses_left);
+void deallocate_lookahead(struct lookahead *la);
+
+#endif
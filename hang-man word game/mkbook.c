@@ -0,0 +1,48 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "book.h"
+#include "reading.h"
+#include "wordindex.h"
+
+/* This program compiles the opening book of a dictionary: for every word
+ * length and every sequence of up to depth guesses (default 2, at most
+ * MAX_BOOK_DEPTH), the family the biggest-family adversary keeps. wheel and
+ * evilsim map the book with -b and answer those guesses by lookup. The
+ * dictionary may be text or an image, but the programs using the book must
+ * load the same words.
+ *
+ * To compile the program:
+ *          make mkbook
+ */
+
+#define DEFAULT_DEPTH 2
+
+int main(int argc, char *argv[]) {
+    int ch;
+    int depth = DEFAULT_DEPTH;
+
+    while ((ch = getopt(argc, argv, "d:")) != -1) {
+        switch (ch) {
+        case 'd':
+            depth = strtol(optarg, NULL, 10);
+            break;
+        default:
+            fprintf(stderr, "Usage: mkbook [-d depth] <dictionary file> <book file>\n");
+            exit(1);
+        }
+    }
+    if (argc - optind != 2 || depth < 0 || depth > MAX_BOOK_DEPTH) {
+        fprintf(stderr, "Usage: mkbook [-d depth] <dictionary file> <book file>\n");
+        exit(1);
+    }
+
+    struct dictionary *dict = load_dictionary(argv[optind]);
+    struct word_index *index = build_word_index(dict);
+    write_book(index, argv[optind + 1], depth);
+    printf("Wrote the opening book of %d words, %d guesses deep, to %s\n", dict->num_words, depth,
+           argv[optind + 1]);
+    deallocate_word_index(index);
+    deallocate_dictionary(dict);
+    return 0;
+}
@@ -0,0 +1,40 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "dictimage.h"
+#include "reading.h"
+
+/* This program compiles a text dictionary, one word per line, into a binary
+ * dictionary image that wheel and wordsrv map read-only at startup instead
+ * of parsing the text. With -m the image also carries the letter-position
+ * mask columns of every word length.
+ *
+ * To compile the program:
+ *          make mkdict
+ */
+
+int main(int argc, char *argv[]) {
+    int ch;
+    int with_masks = 0;
+
+    while ((ch = getopt(argc, argv, "m")) != -1) {
+        switch (ch) {
+        case 'm':
+            with_masks = 1;
+            break;
+        default:
+            fprintf(stderr, "Usage: mkdict [-m] <dictionary file> <image file>\n");
+            exit(1);
+        }
+    }
+    if (argc - optind != 2) {
+        fprintf(stderr, "Usage: mkdict [-m] <dictionary file> <image file>\n");
+        exit(1);
+    }
+
+    struct dictionary *dict = load_dictionary(argv[optind]);
+    write_dict_image(dict, argv[optind + 1], with_masks);
+    printf("Wrote %d words to %s\n", dict->num_words, argv[optind + 1]);
+    deallocate_dictionary(dict);
+    return 0;
+}
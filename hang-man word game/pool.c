@@ -0,0 +1,111 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "pool.h"
+
+/* The work of one pool thread, which does part part of every job. */
+struct pool_thread {
+    struct pool *pool;
+    int part;
+};
+
+
+/* Wait for jobs and run this thread's part of each, until the pool stops. */
+static void *pool_worker(void *arg) {
+    struct pool_thread *self = arg;
+    struct pool *pool = self->pool;
+    int part = self->part;
+    long seen = 0;
+    free(self);
+
+    pthread_mutex_lock(&pool->lock);
+    while (1) {
+        while (pool->generation == seen && !pool->stopping) {
+            pthread_cond_wait(&pool->start, &pool->lock);
+        }
+        if (pool->stopping) {
+            break;
+        }
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+
+        pool->job(pool->arg, part);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->pending == 0) {
+            pthread_cond_signal(&pool->done);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+
+/* Start a pool that runs jobs on num_threads threads, counting the caller. */
+void init_pool(struct pool *pool, int num_threads) {
+    pool->num_threads = num_threads > 0 ? num_threads : 1;
+    pool->generation = 0;
+    pool->pending = 0;
+    pool->stopping = 0;
+    pool->threads = malloc(pool->num_threads * sizeof(pthread_t));
+    if (pool->threads == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    for (int t = 1; t < pool->num_threads; t++) {
+        struct pool_thread *thread = malloc(sizeof(struct pool_thread));
+        if (thread == NULL) {
+            perror("malloc");
+            exit(1);
+        }
+        thread->pool = pool;
+        thread->part = t;
+        if (pthread_create(&pool->threads[t], NULL, pool_worker, thread) != 0) {
+            perror("pthread_create");
+            exit(1);
+        }
+    }
+}
+
+
+/* Run job(arg, part) for every part 0, ..., num_threads - 1 at the same time,
+   and return when all parts have finished.
+*/
+void run_pool(struct pool *pool, void (*job)(void *arg, int part), void *arg) {
+    pthread_mutex_lock(&pool->lock);
+    pool->job = job;
+    pool->arg = arg;
+    pool->pending = pool->num_threads - 1;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    job(arg, 0);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->pending > 0) {
+        pthread_cond_wait(&pool->done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+
+/* Stop the threads of pool and deallocate it. */
+void deallocate_pool(struct pool *pool) {
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = 1;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+    for (int t = 1; t < pool->num_threads; t++) {
+        if (pthread_join(pool->threads[t], NULL) != 0) {
+            perror("pthread_join");
+            exit(1);
+        }
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->start);
+    pthread_cond_destroy(&pool->done);
+    free(pool->threads);
+}
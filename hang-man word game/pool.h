@@ -0,0 +1,27 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <pthread.h>
+
+/* A fixed set of threads that run one job at a time together.
+   A job is split into num_threads parts; the thread calling run_pool does
+   part 0 and the pool's threads do the others.
+*/
+struct pool {
+    int num_threads; /* Threads working on a job, the caller included */
+    pthread_t *threads; /* The pool's own threads */
+    pthread_mutex_t lock;
+    pthread_cond_t start; /* Signalled when a job is posted or the pool stops */
+    pthread_cond_t done; /* Signalled when the last part of a job finishes */
+    long generation; /* Number of jobs posted so far */
+    int pending; /* Parts of the current job still running on pool threads */
+    int stopping; /* 1 once deallocate_pool has been called */
+    void (*job)(void *arg, int part);
+    void *arg;
+};
+
+void init_pool(struct pool *pool, int num_threads);
+void run_pool(struct pool *pool, void (*job)(void *arg, int part), void *arg);
+void deallocate_pool(struct pool *pool);
+
+#endif
@@ -2,54 +2,170 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "dictimage.h"
+
+/* Sort the words of dict by length with a stable counting sort over their
+   offsets, and fill in buckets and max_length. The arena is not moved.
+*/
+static void bucket_by_length(struct dictionary *dict) {
+    int n = dict->num_words;
+    uint32_t *lengths = malloc((n + 1) * sizeof(uint32_t));
+    uint32_t *sorted = malloc((n + 1) * sizeof(uint32_t));
+    if (lengths == NULL || sorted == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+    dict->max_length = 0;
+    for (int i = 0; i < n; i++) {
+        lengths[i] = strlen(get_word(dict, i));
+        if (lengths[i] > dict->max_length) {
+            dict->max_length = lengths[i];
+        }
+    }
+
+    dict->buckets = calloc(dict->max_length + 2, sizeof(uint32_t));
+    uint32_t *next = malloc((dict->max_length + 1) * sizeof(uint32_t));
+    if (dict->buckets == NULL || next == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+    for (int i = 0; i < n; i++) {
+        dict->buckets[lengths[i] + 1]++;
+    }
+    for (int len = 0; len <= dict->max_length; len++) {
+        dict->buckets[len + 1] += dict->buckets[len];
+        next[len] = dict->buckets[len];
+    }
+    for (int i = 0; i < n; i++) {
+        sorted[next[lengths[i]]++] = dict->offsets[i];
+    }
+
+    free(dict->offsets);
+    dict->offsets = sorted;
+    free(lengths);
+    free(next);
+}
 
-/* Read all words from filename and return them in a 2D array. */
-char **read_words(char *filename) {
-    char buffer[MAX_WORD_LENGTH + 1];
-    FILE *fp;
-    int word_count;
-    char **words;
 
-    fp = fopen(filename, "r");
-    if (!fp) {
-      perror("fopen");
+/* Read all words from filename, one per line, and return them as a dictionary.
+   If filename is a dictionary image compiled by mkdict, map it instead.
+
+   The file is read with a single read into the arena, then split in place:
+   lines are found with memchr, which glibc vectorizes, and each newline is
+   replaced by a NUL. There is no limit on the number or length of words.
+   Empty lines are skipped and a trailing '\r' is removed. The words are then
+   bucketed by length, so get_words_of_length needs no search.
+*/
+struct dictionary *load_dictionary(char *filename) {
+    struct dictionary *dict;
+    struct stat sbuf;
+    int fd;
+
+    fd = open(filename, O_RDONLY);
+    if (fd == -1) {
+      perror("open");
       exit(1);
     }
+    if (is_dict_image(fd)) {
+        return map_dict_image(fd, filename);
+    }
+    if (fstat(fd, &sbuf) == -1) {
+        perror("fstat");
+        exit(1);
+    }
+    if ((uint64_t) sbuf.st_size >= UINT32_MAX) {
+        fprintf(stderr, "%s is too large for a dictionary\n", filename);
+        exit(1);
+    }
 
-    word_count = 0;
-    words = malloc(MAX_WORDS * sizeof(*words));
-    if (words == NULL) {
+    dict = calloc(1, sizeof(struct dictionary));
+    if (dict == NULL) {
+        perror("calloc");
+        exit(1);
+    }
+    /* One extra byte terminates a last line that has no newline. */
+    dict->arena_size = sbuf.st_size + 1;
+    dict->arena = malloc(dict->arena_size);
+    if (dict->arena == NULL) {
         perror("malloc");
         exit(1);
     }
-
-    /*Get and store all words*/
-    while (fgets(buffer, MAX_WORD_LENGTH, fp)) {
-        if(buffer[strlen(buffer) - 1] == '\n') {
-            buffer[strlen(buffer) - 1] = '\0'; /*Delete newline*/
-        }
-        words[word_count] = malloc(strlen(buffer) + 1);
-        if (words[word_count] == NULL) {
-            perror("malloc");
+    size_t done = 0;
+    while (done < (size_t) sbuf.st_size) {
+        ssize_t n = read(fd, dict->arena + done, sbuf.st_size - done);
+        if (n == -1) {
+            perror("read");
             exit(1);
         }
+        if (n == 0) {
+            break;
+        }
+        done += n;
+    }
+    close(fd);
+    char *end = dict->arena + done;
+    *end = '\n';
+
+    /* Count the lines first so the offsets array is allocated exactly once. */
+    int max_words = 0;
+    for (char *p = dict->arena; p < end; p++) {
+        p = memchr(p, '\n', end + 1 - p);
+        max_words++;
+    }
+    dict->offsets = malloc((max_words + 1) * sizeof(uint32_t));
+    if (dict->offsets == NULL) {
+        perror("malloc");
+        exit(1);
+    }
 
-        /* strcpy is safe because we just allocated exactly enough space. */
-        strcpy(words[word_count], buffer);
-        word_count++;
+    /*Split the arena into words*/
+    dict->num_words = 0;
+    for (char *p = dict->arena; p < end; ) {
+        char *nl = memchr(p, '\n', end + 1 - p);
+        *nl = '\0';
+        if (nl > p && nl[-1] == '\r') {
+            nl[-1] = '\0'; /*Delete carriage return*/
+        }
+        if (*p != '\0') {
+            dict->offsets[dict->num_words++] = p - dict->arena;
+        }
+        p = nl + 1;
     }
-    words[word_count] = NULL;
+    *end = '\0';
+    bucket_by_length(dict);
+    return dict;
+}
 
-    fclose(fp);
-    return words;
+/* Return word i of dict. */
+char *get_word(struct dictionary *dict, int i) {
+    return dict->arena + dict->offsets[i];
 }
 
-/* Deallocate all memory acquired by read_words. */
-void deallocate_words(char **words) {
-    char **p = words;
-    while(*p) {
-        free(*p);
-        p++;
+/* Return the number of words of length len in dict, and store the index of
+   the first of them in first. The words are first, first + 1, ... in order.
+*/
+int get_words_of_length(struct dictionary *dict, int len, int *first) {
+    if (len < 0 || len > dict->max_length) {
+        *first = 0;
+        return 0;
+    }
+    *first = dict->buckets[len];
+    return dict->buckets[len + 1] - dict->buckets[len];
+}
+
+
+/* Deallocate all memory acquired by load_dictionary. */
+void deallocate_dictionary(struct dictionary *dict) {
+    if (dict->image != NULL) {
+        munmap(dict->image, dict->image_size);
+    } else {
+        free(dict->arena);
+        free(dict->offsets);
+        free(dict->buckets);
     }
-    free(words);
+    free(dict);
 }
@@ -1,16 +1,35 @@
 #ifndef READING_H
 #define READING_H
 
-/* Maximum length of word to read. */
-#define MAX_WORD_LENGTH 40
-
-/* Maximum number of words in the dictionary. */
-#define MAX_WORDS 130000
+#include <stddef.h>
+#include <stdint.h>
 
 /* Dictionary file name */
 #define DICTIONARY "dictionary.txt"
 
-char **read_words(char *filename);
-void deallocate_words(char **words);
+/* A dictionary loaded into one contiguous string arena.
+   Word i is the NUL-terminated string at arena + offsets[i].
+   The words are sorted by length, keeping their file order within a length,
+   so the words of each length are one contiguous range of indexes.
+
+   A dictionary mapped from a binary image (see dictimage.h) points into the
+   read-only mapping instead, and may also have the word_index mask columns.
+*/
+struct dictionary {
+    char *arena; /* All words, each NUL-terminated, back to back */
+    size_t arena_size; /* Number of bytes in arena */
+    uint32_t *offsets; /* offsets[i] is where word i starts in arena */
+    int num_words; /* Number of words */
+    int max_length; /* Length of the longest word */
+    uint32_t *buckets; /* The words of length len are [buckets[len], buckets[len + 1]) */
+    uint64_t *masks; /* Precomputed mask columns of every word_group, or NULL */
+    void *image; /* The mapped image, or NULL if loaded from text */
+    size_t image_size; /* Size of the mapping */
+};
+
+struct dictionary *load_dictionary(char *filename);
+char *get_word(struct dictionary *dict, int i);
+int get_words_of_length(struct dictionary *dict, int len, int *first);
+void deallocate_dictionary(struct dictionary *dict);
 
 #endif
@@ -0,0 +1,796 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pool.h"
+#include "round.h"
+#include "util.h"
+#include "wordindex.h"
+
+
+/* Give arena size bytes of memory to hand out. */
+void init_arena(struct arena *arena, size_t size) {
+    arena->base = malloc(size > 0 ? size : 1);
+    if (arena->base == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+    arena->size = size;
+    arena->used = 0;
+}
+
+
+/* Return size bytes from arena, aligned for any scalar type.
+   Running out is a sizing bug, so it is fatal.
+*/
+void *arena_alloc(struct arena *arena, size_t size) {
+    size_t start = (arena->used + 7) & ~(size_t) 7;
+    if (start + size > arena->size) {
+        fprintf(stderr, "arena_alloc: %zu bytes requested, %zu of %zu in use\n",
+                size, arena->used, arena->size);
+        exit(1);
+    }
+    arena->used = start + size;
+    return arena->base + start;
+}
+
+
+/* Free everything allocated from arena. */
+void reset_arena(struct arena *arena) {
+    arena->used = 0;
+}
+
+
+/* Deallocate the memory of arena. */
+void free_arena(struct arena *arena) {
+    free(arena->base);
+    arena->base = NULL;
+    arena->size = arena->used = 0;
+}
+
+
+/* Return the number of hash table slots used to partition n words:
+   a power of two, so the table never fills beyond half.
+*/
+static int partition_slots(int n) {
+    int num_slots = 16;
+    while (num_slots < 2 * n) {
+        num_slots *= 2;
+    }
+    return num_slots;
+}
+
+
+/* Return the arena size partition_range needs for n candidates:
+   the hash table, the family of each word and up to n families.
+*/
+size_t partition_scratch_size(int n) {
+    return (size_t) partition_slots(n) * sizeof(int)
+        + (size_t) n * (sizeof(int) + 2 * sizeof(uint64_t) + 2 * sizeof(int))
+        + 6 * 8;
+}
+
+
+/* Return the most distinct (letter, nonzero signature) pairs n words of
+   the given length can have: each word has at most one per letter it
+   contains, and each letter has at most 2^length - 1 nonzero signatures.
+*/
+static long max_letter_signatures(int n, int length) {
+    long bound = (long) n * (length < NUM_LETTERS ? length : NUM_LETTERS);
+    if (length < 32 && NUM_LETTERS * (((long) 1 << length) - 1) < bound) {
+        bound = NUM_LETTERS * (((long) 1 << length) - 1);
+    }
+    return bound;
+}
+
+
+/* Words at most this long have their letter stats counted in a table
+   indexed directly by letter and signature instead of a hash table.
+*/
+#define DIRECT_STATS_BITS 10
+
+
+/* One family of get_letter_stats: a letter and its signature. */
+struct letter_family {
+    uint64_t mask; /* Signature mask; never 0 in a used slot */
+    int letter; /* Letter index, 0 for 'a' */
+    int num_words; /* Number of words in the family */
+};
+
+
+/* Return the arena size get_letter_stats needs for n words of the given length. */
+static size_t stats_scratch_size(int n, int length) {
+    if (length <= DIRECT_STATS_BITS) {
+        return ((size_t) NUM_LETTERS << length) * sizeof(int) + 8;
+    }
+    return (size_t) partition_slots(max_letter_signatures(n, length)) * sizeof(struct letter_family) + 8;
+}
+
+
+/* Allocate everything round needs to play games over any group of index. */
+void init_round(struct round *round, struct word_index *index) {
+    round->max_ids = 1;
+    for (int len = 0; len <= index->max_length; len++) {
+        if (index->groups[len].num_words > round->max_ids) {
+            round->max_ids = index->groups[len].num_words;
+        }
+    }
+    round->ids = malloc(round->max_ids * sizeof(int));
+    round->spare = malloc(round->max_ids * sizeof(int));
+    round->column = malloc(round->max_ids * sizeof(uint64_t));
+    round->pattern = malloc(index->max_length + 1);
+    if (round->ids == NULL || round->spare == NULL || round->column == NULL
+        || round->pattern == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+    // A guess's families stay in the arena while the next letter stats are computed.
+    size_t stats_size = 0;
+    for (int len = 0; len <= index->max_length; len++) {
+        size_t size = stats_scratch_size(index->groups[len].num_words, len);
+        if (size > stats_size) {
+            stats_size = size;
+        }
+    }
+    round->stats_size = stats_size;
+    init_arena(&round->arena, partition_scratch_size(round->max_ids) + stats_size);
+    round->pool = NULL;
+    round->book = NULL;
+    round->book_node = 0;
+    round->book_guesses = 0;
+    round->tracer = NULL;
+    memset(&round->trace, 0, sizeof(round->trace));
+    round->group = NULL;
+    round->first = round->num_ids = 0;
+    round->families.num_fams = 0;
+    round->kept = -1;
+}
+
+
+/* Start a game over the words of group, which must have signatures:
+   every word is a candidate and nothing is revealed.
+*/
+void start_round(struct round *round, struct word_group *group) {
+    round->group = group;
+    round->first = 0;
+    round->num_ids = group->num_words;
+    for (int i = 0; i < group->num_words; i++) {
+        round->ids[i] = i;
+    }
+    memset(round->pattern, '-', group->length);
+    round->pattern[group->length] = '\0';
+    memset(&round->trace, 0, sizeof(round->trace));
+    round->book_guesses = 0;
+    round->book_node = 0;
+    if (round->book != NULL && group->length <= round->book->max_length) {
+        round->book_node = round->book->roots[group->length];
+    }
+    reset_arena(&round->arena);
+    round->families.num_fams = 0;
+    round->kept = -1;
+}
+
+
+/* Partition the n candidate indexes ids[first], ..., ids[first + n - 1] by
+   their signature masks in column into part. Each family becomes a subrange
+   of that range; words keep their order within a family, and the rest of ids
+   is untouched. spare must have room for the same range. If keys is not
+   NULL, part->hashes[f] is the XOR of keys[id] over the words of family f.
+
+   A first pass finds each word's family through an open-addressing hash
+   table and counts the families; the counts give every family a subrange,
+   and a second pass scatters the indexes into them. All memory comes from
+   arena, which must have partition_scratch_size(n) bytes free.
+*/
+void partition_range(struct arena *arena, uint64_t *column, int *ids, int *spare,
+                     int first, int n, const uint64_t *keys, struct partition *part) {
+    int num_slots = partition_slots(n);
+    int *slots = arena_alloc(arena, num_slots * sizeof(int));
+    int *fam_of_word = arena_alloc(arena, n * sizeof(int));
+    uint64_t *fam_masks = arena_alloc(arena, n * sizeof(uint64_t));
+    int *fam_starts = arena_alloc(arena, n * sizeof(int));
+    int *fam_counts = arena_alloc(arena, n * sizeof(int));
+    uint64_t *fam_hashes = keys != NULL ? arena_alloc(arena, n * sizeof(uint64_t)) : NULL;
+    memset(slots, -1, num_slots * sizeof(int));
+
+    int *range = ids + first;
+    int num_fams = 0, biggest = -1, biggest_words = 0;
+    for (int i = 0; i < n; i++) {
+        uint64_t mask = column[range[i]];
+        uint64_t h = mask * 0x9e3779b97f4a7c15ULL;
+        int slot = (int) (h >> 32) & (num_slots - 1);
+        while (slots[slot] != -1 && fam_masks[slots[slot]] != mask) {
+            slot = (slot + 1) & (num_slots - 1);
+        }
+        if (slots[slot] == -1) {
+            fam_masks[num_fams] = mask;
+            fam_counts[num_fams] = 0;
+            if (fam_hashes != NULL) {
+                fam_hashes[num_fams] = 0;
+            }
+            slots[slot] = num_fams++;
+        }
+        int f = slots[slot];
+        fam_of_word[i] = f;
+        if (fam_hashes != NULL) {
+            fam_hashes[f] ^= keys[range[i]];
+        }
+        if (++fam_counts[f] > biggest_words) {
+            biggest_words = fam_counts[f];
+            biggest = f;
+        }
+    }
+
+    // Lay the families out in order over the range; the hash table is
+    // no longer needed, so it holds each family's next free position.
+    int start = first;
+    for (int f = 0; f < num_fams; f++) {
+        fam_starts[f] = start;
+        slots[f] = start;
+        start += fam_counts[f];
+    }
+    for (int i = 0; i < n; i++) {
+        spare[slots[fam_of_word[i]]++] = range[i];
+    }
+    memcpy(range, spare + first, n * sizeof(int));
+
+    part->num_fams = num_fams;
+    part->masks = fam_masks;
+    part->starts = fam_starts;
+    part->counts = fam_counts;
+    part->hashes = fam_hashes;
+    part->biggest = biggest;
+}
+
+
+/* One thread's share of a parallel partition: the candidates
+   range[lo], ..., range[hi - 1] and their families in order of first appearance.
+*/
+struct partition_chunk {
+    int lo, hi;
+    int num_slots;
+    int *slots; /* Open-addressing hash table of indexes into the families */
+    int num_fams;
+    uint64_t *masks;
+    int *counts;
+    int *last; /* Position in the range of each family's last word */
+    uint64_t *hashes; /* XOR of the keys of each family's words, or NULL */
+    int *next; /* Global family of each family, then where its next word goes */
+};
+
+/* A parallel partition in progress; see partition_range_parallel. */
+struct partition_job {
+    uint64_t *column;
+    int *range; /* The candidates being partitioned */
+    int *spare_range; /* Where they are scattered to */
+    const uint64_t *keys;
+    int *fam_of_word; /* Family of each candidate, within its chunk */
+    struct partition_chunk *chunks;
+    enum {COUNT_FAMILIES, SCATTER_WORDS, COPY_BACK} phase;
+};
+
+
+/* Run the current phase of a parallel partition on chunk part. */
+static void partition_chunk_job(void *arg, int part) {
+    struct partition_job *job = arg;
+    struct partition_chunk *chunk = &job->chunks[part];
+
+    if (job->phase == COUNT_FAMILIES) {
+        int mask_slots = chunk->num_slots - 1;
+        memset(chunk->slots, -1, chunk->num_slots * sizeof(int));
+        chunk->num_fams = 0;
+        for (int i = chunk->lo; i < chunk->hi; i++) {
+            uint64_t mask = job->column[job->range[i]];
+            int slot = (int) ((mask * 0x9e3779b97f4a7c15ULL) >> 32) & mask_slots;
+            while (chunk->slots[slot] != -1 && chunk->masks[chunk->slots[slot]] != mask) {
+                slot = (slot + 1) & mask_slots;
+            }
+            if (chunk->slots[slot] == -1) {
+                chunk->masks[chunk->num_fams] = mask;
+                chunk->counts[chunk->num_fams] = 0;
+                if (chunk->hashes != NULL) {
+                    chunk->hashes[chunk->num_fams] = 0;
+                }
+                chunk->slots[slot] = chunk->num_fams++;
+            }
+            int f = chunk->slots[slot];
+            job->fam_of_word[i] = f;
+            chunk->counts[f]++;
+            chunk->last[f] = i;
+            if (chunk->hashes != NULL) {
+                chunk->hashes[f] ^= job->keys[job->range[i]];
+            }
+        }
+    } else if (job->phase == SCATTER_WORDS) {
+        for (int i = chunk->lo; i < chunk->hi; i++) {
+            job->spare_range[chunk->next[job->fam_of_word[i]]++] = job->range[i];
+        }
+    } else {
+        memcpy(job->range + chunk->lo, job->spare_range + chunk->lo,
+               (chunk->hi - chunk->lo) * sizeof(int));
+    }
+}
+
+
+/* Return the arena size partition_range_parallel needs for n candidates
+   split into num_parts chunks.
+*/
+size_t parallel_partition_scratch_size(int n, int num_parts) {
+    int chunk_words = n / num_parts + 1;
+    size_t chunk_size = (size_t) partition_slots(chunk_words) * sizeof(int)
+        + (size_t) chunk_words * (2 * sizeof(uint64_t) + 3 * sizeof(int)) + 6 * 8;
+    return sizeof(struct partition_chunk) * num_parts + 8
+        + num_parts * chunk_size
+        + (size_t) n * sizeof(int) + 8
+        + partition_scratch_size(n) + (size_t) n * sizeof(int) + 8;
+}
+
+
+/* Partition candidates exactly as partition_range does, with the work split
+   over the threads of pool.
+
+   Each thread counts the families of one chunk of the range in its own hash
+   table. The chunks are then merged in order on the calling thread, which
+   keeps the families in order of first appearance; the biggest family is
+   the one of the most words whose last word comes first, which is the one
+   partition_range's running count picks. Each chunk's words of each family
+   go after those of the chunks before it, so the threads can scatter their
+   chunks at once and words still keep their order within a family.
+   All memory comes from arena, which must have
+   parallel_partition_scratch_size(n, pool->num_threads) bytes free.
+*/
+void partition_range_parallel(struct pool *pool, struct arena *arena, uint64_t *column,
+                              int *ids, int *spare, int first, int n, const uint64_t *keys,
+                              struct partition *part) {
+    int num_parts = pool->num_threads;
+    struct partition_job job;
+    job.column = column;
+    job.range = ids + first;
+    job.spare_range = spare + first;
+    job.keys = keys;
+    job.chunks = arena_alloc(arena, num_parts * sizeof(struct partition_chunk));
+    job.fam_of_word = arena_alloc(arena, n * sizeof(int));
+    for (int t = 0; t < num_parts; t++) {
+        struct partition_chunk *chunk = &job.chunks[t];
+        chunk->lo = (long) n * t / num_parts;
+        chunk->hi = (long) n * (t + 1) / num_parts;
+        int chunk_words = chunk->hi - chunk->lo;
+        chunk->num_slots = partition_slots(chunk_words);
+        chunk->slots = arena_alloc(arena, chunk->num_slots * sizeof(int));
+        chunk->masks = arena_alloc(arena, chunk_words * sizeof(uint64_t));
+        chunk->counts = arena_alloc(arena, chunk_words * sizeof(int));
+        chunk->last = arena_alloc(arena, chunk_words * sizeof(int));
+        chunk->next = arena_alloc(arena, chunk_words * sizeof(int));
+        chunk->hashes = keys != NULL ? arena_alloc(arena, chunk_words * sizeof(uint64_t)) : NULL;
+    }
+    job.phase = COUNT_FAMILIES;
+    run_pool(pool, partition_chunk_job, &job);
+
+    // Merge the chunks' families, in order, into the families of the range.
+    int num_slots = partition_slots(n);
+    int *slots = arena_alloc(arena, num_slots * sizeof(int));
+    uint64_t *fam_masks = arena_alloc(arena, n * sizeof(uint64_t));
+    int *fam_starts = arena_alloc(arena, n * sizeof(int));
+    int *fam_counts = arena_alloc(arena, n * sizeof(int));
+    int *fam_last = arena_alloc(arena, n * sizeof(int));
+    uint64_t *fam_hashes = keys != NULL ? arena_alloc(arena, n * sizeof(uint64_t)) : NULL;
+    memset(slots, -1, num_slots * sizeof(int));
+    int num_fams = 0;
+    for (int t = 0; t < num_parts; t++) {
+        struct partition_chunk *chunk = &job.chunks[t];
+        for (int f = 0; f < chunk->num_fams; f++) {
+            uint64_t mask = chunk->masks[f];
+            int slot = (int) ((mask * 0x9e3779b97f4a7c15ULL) >> 32) & (num_slots - 1);
+            while (slots[slot] != -1 && fam_masks[slots[slot]] != mask) {
+                slot = (slot + 1) & (num_slots - 1);
+            }
+            if (slots[slot] == -1) {
+                fam_masks[num_fams] = mask;
+                fam_counts[num_fams] = 0;
+                if (fam_hashes != NULL) {
+                    fam_hashes[num_fams] = 0;
+                }
+                slots[slot] = num_fams++;
+            }
+            int g = slots[slot];
+            chunk->next[f] = g;
+            fam_counts[g] += chunk->counts[f];
+            fam_last[g] = chunk->last[f];
+            if (fam_hashes != NULL) {
+                fam_hashes[g] ^= chunk->hashes[f];
+            }
+        }
+    }
+
+    int biggest = 0, start = 0;
+    for (int g = 0; g < num_fams; g++) {
+        if (fam_counts[g] > fam_counts[biggest]
+            || (fam_counts[g] == fam_counts[biggest] && fam_last[g] < fam_last[biggest])) {
+            biggest = g;
+        }
+        // The hash table is no longer needed, so it holds each family's next free position.
+        fam_starts[g] = first + start;
+        slots[g] = start;
+        start += fam_counts[g];
+    }
+    for (int t = 0; t < num_parts; t++) {
+        struct partition_chunk *chunk = &job.chunks[t];
+        for (int f = 0; f < chunk->num_fams; f++) {
+            int g = chunk->next[f];
+            chunk->next[f] = slots[g];
+            slots[g] += chunk->counts[f];
+        }
+    }
+    job.phase = SCATTER_WORDS;
+    run_pool(pool, partition_chunk_job, &job);
+    job.phase = COPY_BACK;
+    run_pool(pool, partition_chunk_job, &job);
+
+    part->num_fams = num_fams;
+    part->masks = fam_masks;
+    part->starts = fam_starts;
+    part->counts = fam_counts;
+    part->hashes = fam_hashes;
+    part->biggest = biggest;
+}
+
+
+/* Let round partition big candidate sets on the threads of pool,
+   or on the calling thread alone if pool is NULL.
+*/
+void set_round_pool(struct round *round, struct pool *pool) {
+    size_t size = partition_scratch_size(round->max_ids);
+    if (pool != NULL && parallel_partition_scratch_size(round->max_ids, pool->num_threads) > size) {
+        size = parallel_partition_scratch_size(round->max_ids, pool->num_threads);
+    }
+    free_arena(&round->arena);
+    init_arena(&round->arena, size + round->stats_size);
+    round->pool = pool;
+    round->families.num_fams = 0;
+    round->kept = -1;
+}
+
+
+/* Let round answer the first guesses of its games from book, or from
+   partitions alone if book is NULL. The book must be built from the words
+   of the round's index.
+*/
+void set_round_book(struct round *round, struct book *book) {
+    round->book = book;
+    round->book_node = 0;
+    round->book_guesses = 0;
+}
+
+
+/* Write the costs of every guess of round to tracer, or stop tracing if
+   tracer is NULL.
+*/
+void set_round_tracer(struct round *round, struct tracer *tracer) {
+    round->tracer = tracer;
+    memset(&round->trace, 0, sizeof(round->trace));
+}
+
+
+/* Return the time a phase of the guess in progress starts at if round is
+   traced, or 0 without reading the clock if it is not.
+*/
+long begin_round_phase(struct round *round) {
+    return round->tracer != NULL ? now_ns() : 0;
+}
+
+
+/* Charge the time since start and words words scanned to phase of the guess
+   in progress, if round is traced, and note the scratch memory in use.
+*/
+void end_round_phase(struct round *round, enum guess_phase phase, long start, long words) {
+    if (round->tracer == NULL) {
+        return;
+    }
+    round->trace.phase_ns[phase] += now_ns() - start;
+    round->trace.words_scanned += words;
+    if (round->arena.used > round->trace.arena_bytes) {
+        round->trace.arena_bytes = round->arena.used;
+    }
+}
+
+
+/* Fill ids with the candidates of round if guesses answered by the book
+   have left it stale: the words of the group, in order, whose signature for
+   each of those guesses is the one the book kept. The game then leaves the
+   book for good.
+*/
+void materialize_round(struct round *round) {
+    round->book_node = 0;
+    if (round->book_guesses == 0) {
+        return;
+    }
+    // Each guess filters the words that passed the ones before, in place.
+    long start = begin_round_phase(round);
+    long scanned = 0;
+    struct word_group *group = round->group;
+    int n = group->num_words;
+    for (int i = 0; i < n; i++) {
+        round->ids[i] = i;
+    }
+    for (int k = 0; k < round->book_guesses; k++) {
+        uint64_t *column = get_candidate_column(group, round->book_letters[k], round->ids, n,
+                                                round->column);
+        int kept = 0;
+        for (int i = 0; i < n; i++) {
+            if (column[round->ids[i]] == round->book_masks[k]) {
+                round->ids[kept++] = round->ids[i];
+            }
+        }
+        scanned += n;
+        n = kept;
+    }
+    round->first = 0;
+    round->num_ids = n;
+    round->book_guesses = 0;
+    end_round_phase(round, PHASE_MATERIALIZE, start, scanned);
+}
+
+
+/* Answer a guess of letter from the round's opening book if the game is
+   still in it: shrink the candidates to the book's family without
+   partitioning, reveal letter where the family has it, store its signature
+   mask in *mask and return 1. Return 0 if the book has no answer, or if
+   the node's children lie outside the book or the family is bigger than
+   the candidates it is split from: load_book leaves the nodes unread.
+*/
+static int book_guess(struct round *round, char letter, uint64_t *mask) {
+    if (round->book_node == 0 || round->book_guesses == MAX_BOOK_DEPTH) {
+        return 0;
+    }
+    struct book *book = round->book;
+    uint32_t children = book->nodes[round->book_node].children;
+    if (children == 0 || (uint64_t) children + NUM_LETTERS > book->num_nodes) {
+        return 0;
+    }
+    struct book_node *node = &book->nodes[children + letter - 'a'];
+    if (node->count == 0 || node->count > (uint32_t) round->num_ids) {
+        return 0;
+    }
+    round->book_node = children + letter - 'a';
+    round->book_letters[round->book_guesses] = letter;
+    round->book_masks[round->book_guesses] = node->mask;
+    round->book_guesses++;
+    round->num_ids = node->count;
+    round->families.num_fams = 0;
+    round->kept = -1;
+    for (int j = 0; j < round->group->length; j++) {
+        if ((node->mask >> j) & 1) {
+            round->pattern[j] = letter;
+        }
+    }
+    *mask = node->mask;
+    return 1;
+}
+
+
+/* Partition the candidates of round by their signature for letter and keep
+   family f, revealing letter in the pattern where the family has it.
+   Return the family's signature mask.
+*/
+static uint64_t keep_family(struct round *round, char letter, int f) {
+    long start = begin_round_phase(round);
+    round->kept = f;
+    round->first = round->families.starts[f];
+    round->num_ids = round->families.counts[f];
+
+    uint64_t mask = round->families.masks[f];
+    for (int j = 0; j < round->group->length; j++) {
+        if ((mask >> j) & 1) {
+            round->pattern[j] = letter;
+        }
+    }
+    end_round_phase(round, PHASE_KEEP, start, 0);
+    return mask;
+}
+
+
+/* Write the costs of the guess of letter that round has just made to its
+   tracer, if it has one, and start on the next guess. candidates is the
+   number of candidates before the guess.
+*/
+static void finish_guess(struct round *round, char letter, int candidates) {
+    if (round->tracer == NULL) {
+        return;
+    }
+    struct guess_trace *trace = &round->trace;
+    trace->length = round->group->length;
+    trace->letter = letter;
+    trace->candidates = candidates;
+    trace->kept = round->num_ids;
+    trace->families = round->families.num_fams;
+    trace->biggest = round->kept >= 0 ? round->families.counts[round->families.biggest]
+        : round->num_ids;
+    write_guess_trace(round->tracer, trace);
+    memset(trace, 0, sizeof(*trace));
+}
+
+
+/* Partition the candidates of round into round->families by their signature
+   for letter, with the arena reset first; on the round's pool if it has one
+   and there are enough candidates.
+*/
+static void split_round(struct round *round, char letter) {
+    materialize_round(round);
+    long start = begin_round_phase(round);
+    uint64_t *column = get_candidate_column(round->group, letter, round->ids + round->first,
+                                            round->num_ids, round->column);
+    reset_arena(&round->arena);
+    if (round->pool != NULL && round->num_ids >= PARALLEL_PARTITION_MIN) {
+        partition_range_parallel(round->pool, &round->arena, column, round->ids, round->spare,
+                                 round->first, round->num_ids, NULL, &round->families);
+    } else {
+        partition_range(&round->arena, column, round->ids, round->spare,
+                        round->first, round->num_ids, NULL, &round->families);
+    }
+    end_round_phase(round, PHASE_PARTITION, start, round->num_ids);
+}
+
+
+/* Partition the candidates of round by their signature for letter and keep
+   the biggest family; ties go to the family that got there first, as with
+   generate_families. Reveal letter in the pattern where the family has it,
+   and return the family's signature mask (0 if letter is not in the word).
+   The only memory used comes from the arena.
+*/
+uint64_t partition_round(struct round *round, char letter) {
+    int candidates = round->num_ids;
+    long start = begin_round_phase(round);
+    uint64_t mask;
+    if (book_guess(round, letter, &mask)) {
+        end_round_phase(round, PHASE_BOOK, start, 0);
+    } else {
+        split_round(round, letter);
+        mask = keep_family(round, letter, round->families.biggest);
+    }
+    finish_guess(round, letter, candidates);
+    return mask;
+}
+
+
+/* Like partition_round, but keep the family with signature mask, as chosen
+   by an adversary such as choose_family. If there is no such family, keep
+   the biggest.
+*/
+uint64_t partition_round_keep(struct round *round, char letter, uint64_t mask) {
+    int candidates = round->num_ids;
+    split_round(round, letter);
+    int f = round->families.biggest;
+    for (int i = 0; i < round->families.num_fams; i++) {
+        if (round->families.masks[i] == mask) {
+            f = i;
+            break;
+        }
+    }
+    mask = keep_family(round, letter, f);
+    finish_guess(round, letter, candidates);
+    return mask;
+}
+
+
+/* Count the word with signature mask for letter c in the hash table
+   slots of get_letter_stats, updating stats[c].
+*/
+static void count_letter_family(struct letter_family *slots, int num_slots,
+                                int c, uint64_t mask, struct letter_stats *stats) {
+    // The letter goes in the low bits, which the multiply spreads to the slot bits.
+    uint64_t h = ((mask << 5) | c) * 0x9e3779b97f4a7c15ULL;
+    int slot = (int) (h >> 32) & (num_slots - 1);
+    while (slots[slot].mask != 0 && (slots[slot].mask != mask || slots[slot].letter != c)) {
+        slot = (slot + 1) & (num_slots - 1);
+    }
+    if (slots[slot].mask == 0) {
+        slots[slot].mask = mask;
+        slots[slot].letter = c;
+        stats->num_fams++;
+    }
+    if (++slots[slot].num_words > stats->biggest) {
+        stats->biggest = slots[slot].num_words;
+    }
+}
+
+
+/* Fill stats[c] with the number of families and the size of the biggest
+   family that guessing letter 'a' + c would split the candidates of round
+   into, for every letter not yet guessed (letters_guessed[c] is 0).
+
+   This takes one pass over the candidates instead of one partition per
+   letter: each word's signatures for all those letters are built at once
+   (see get_word_signatures), and every nonzero signature is counted as a
+   (letter, signature) family. Short words index a table of counts by letter
+   and signature directly; longer ones share one hash table. The words without a letter
+   form that letter's family with signature 0, which is counted apart.
+   The tables come from the arena, above the last guess's families, which
+   stay valid.
+*/
+void get_letter_stats(struct round *round, char *letters_guessed,
+                      struct letter_stats stats[NUM_LETTERS]) {
+    struct word_group *group = round->group;
+    int length = group->length;
+    int n = round->num_ids;
+    uint32_t wanted = 0; /* Bit c is set if letter c is not guessed yet */
+    int has_letter[NUM_LETTERS] = {0}; /* Number of words containing each letter */
+
+    for (int c = 0; c < NUM_LETTERS; c++) {
+        stats[c].num_fams = stats[c].biggest = 0;
+        if (!letters_guessed[c]) {
+            wanted |= (uint32_t) 1 << c;
+        }
+    }
+
+    materialize_round(round);
+    long start = begin_round_phase(round);
+    size_t mark = round->arena.used;
+    int *counts = NULL; /* counts[(c << length) + mask], for short words */
+    struct letter_family *slots = NULL; /* Hash table, for long words */
+    int num_slots = 0;
+    if (length <= DIRECT_STATS_BITS) {
+        counts = arena_alloc(&round->arena, ((size_t) NUM_LETTERS << length) * sizeof(int));
+        memset(counts, 0, ((size_t) NUM_LETTERS << length) * sizeof(int));
+    } else {
+        num_slots = partition_slots(max_letter_signatures(n, length));
+        slots = arena_alloc(&round->arena, num_slots * sizeof(struct letter_family));
+        memset(slots, 0, num_slots * sizeof(struct letter_family));
+    }
+
+    int *range = round->ids + round->first;
+    for (int i = 0; i < n; i++) {
+        uint64_t masks[NUM_LETTERS];
+        uint32_t present = get_word_signatures(group, range[i], wanted, masks);
+
+        for (uint32_t todo = present; todo != 0; todo &= todo - 1) {
+            int c = __builtin_ctz(todo);
+            has_letter[c]++;
+            if (counts != NULL) {
+                int *count = &counts[((size_t) c << length) + masks[c]];
+                if (*count == 0) {
+                    stats[c].num_fams++;
+                }
+                if (++*count > stats[c].biggest) {
+                    stats[c].biggest = *count;
+                }
+            } else {
+                count_letter_family(slots, num_slots, c, masks[c], &stats[c]);
+            }
+        }
+    }
+
+    // Add each letter's family of words without it.
+    for (int c = 0; c < NUM_LETTERS; c++) {
+        if ((wanted & ((uint32_t) 1 << c)) && has_letter[c] < n) {
+            stats[c].num_fams++;
+            if (n - has_letter[c] > stats[c].biggest) {
+                stats[c].biggest = n - has_letter[c];
+            }
+        }
+    }
+    // The tables are only needed until now.
+    end_round_phase(round, PHASE_STATS, start, n);
+    round->arena.used = mark;
+}
+
+
+/* Return candidate i of round, 0 <= i < num_ids. */
+char *get_round_word(struct round *round, int i) {
+    materialize_round(round);
+    return round->group->words[round->ids[round->first + i]];
+}
+
+
+/* Return a random candidate of round. Use rand, seeded by init_family. */
+char *get_random_round_word(struct round *round) {
+    return get_round_word(round, rand() % round->num_ids);
+}
+
+
+/* Deallocate all memory acquired by init_round. */
+void deallocate_round(struct round *round) {
+    free(round->ids);
+    free(round->spare);
+    free(round->column);
+    free(round->pattern);
+    free_arena(&round->arena);
+}
@@ -0,0 +1,109 @@
+#ifndef ROUND_H
+#define ROUND_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "book.h"
+#include "trace.h"
+#include "wordindex.h"
+
+/* Rounds with a thread pool partition at least this many candidates in parallel. */
+#define PARALLEL_PARTITION_MIN 8192
+
+/* A bump allocator for scratch memory that lives for one guess.
+   Allocation moves used forward; reset_arena frees everything at once.
+*/
+struct arena {
+    char *base; /* The memory handed out */
+    size_t size; /* Number of bytes in base */
+    size_t used; /* Number of bytes handed out since the last reset */
+};
+
+void init_arena(struct arena *arena, size_t size);
+void *arena_alloc(struct arena *arena, size_t size);
+void reset_arena(struct arena *arena);
+void free_arena(struct arena *arena);
+
+struct pool;
+
+/* The families of one partition of a range of candidate indexes, in order
+   of first appearance: family f has signature masks[f] and is the subrange
+   of counts[f] indexes starting at starts[f].
+*/
+struct partition {
+    int num_fams; /* Number of families */
+    uint64_t *masks;
+    int *starts;
+    int *counts;
+    uint64_t *hashes; /* XOR of the keys of each family's words, if keys were given */
+    int biggest; /* The family with the most words; ties go to the first to get there */
+};
+
+/* The state of one game of evil hangman over a word_group.
+
+   The candidates are the words of the group whose indexes are
+   ids[first], ..., ids[first + num_ids - 1]. A guess partitions that range in
+   place by signature, counting-sort style, into one subrange per family, and
+   the range shrinks to one family, normally the biggest. The families of the
+   last guess stay readable until the next one; they live in the arena.
+
+   With an opening book, the first guesses only follow the book: ids is
+   filled in with the candidates left (see materialize_round) when the game
+   leaves the book or something needs them, and there are no families.
+
+   All memory is allocated by init_round, sized for the biggest group of the
+   index, so playing any number of games allocates nothing.
+*/
+struct round {
+    struct word_group *group; /* The words of the game */
+    int *ids; /* Candidate word indexes; see above */
+    int *spare; /* Scratch space for partitioning ids */
+    uint64_t *column; /* Signatures of the candidates, for groups without mask columns */
+    int first; /* Position in ids of the first candidate */
+    int num_ids; /* Number of candidates */
+    int max_ids; /* Number of indexes ids has room for */
+    char *pattern; /* The word as revealed so far; each blank is a - */
+    struct arena arena; /* Scratch memory of the current guess */
+    size_t stats_size; /* Bytes of the arena get_letter_stats may need */
+    struct partition families; /* The families of the last guess */
+    int kept; /* Index of the family the candidates shrank to, or -1 */
+    struct pool *pool; /* Threads that partition big candidate sets, or NULL */
+    struct book *book; /* Opening book that answers the first guesses, or NULL */
+    uint32_t book_node; /* Book node of the guesses so far, or 0 outside the book */
+    int book_guesses; /* Guesses answered by the book since ids was last valid */
+    char book_letters[MAX_BOOK_DEPTH]; /* Those guesses */
+    uint64_t book_masks[MAX_BOOK_DEPTH]; /* The signatures of the families they kept */
+    struct tracer *tracer; /* Where each guess's costs are written, or NULL */
+    struct guess_trace trace; /* Costs of the guess in progress, if traced */
+};
+
+/* What guessing one letter would do to the candidates of a round. */
+struct letter_stats {
+    int num_fams; /* Number of families the guess would produce; 0 if already guessed */
+    int biggest; /* Number of words in the biggest of them */
+};
+
+void init_round(struct round *round, struct word_index *index);
+void start_round(struct round *round, struct word_group *group);
+size_t partition_scratch_size(int n);
+void partition_range(struct arena *arena, uint64_t *column, int *ids, int *spare,
+                     int first, int n, const uint64_t *keys, struct partition *part);
+size_t parallel_partition_scratch_size(int n, int num_parts);
+void partition_range_parallel(struct pool *pool, struct arena *arena, uint64_t *column,
+                              int *ids, int *spare, int first, int n, const uint64_t *keys,
+                              struct partition *part);
+void set_round_pool(struct round *round, struct pool *pool);
+void set_round_book(struct round *round, struct book *book);
+void materialize_round(struct round *round);
+void set_round_tracer(struct round *round, struct tracer *tracer);
+long begin_round_phase(struct round *round);
+void end_round_phase(struct round *round, enum guess_phase phase, long start, long words);
+uint64_t partition_round(struct round *round, char letter);
+uint64_t partition_round_keep(struct round *round, char letter, uint64_t mask);
+void get_letter_stats(struct round *round, char *letters_guessed,
+                      struct letter_stats stats[NUM_LETTERS]);
+char *get_round_word(struct round *round, int i);
+char *get_random_round_word(struct round *round);
+void deallocate_round(struct round *round);
+
+#endif
@@ -0,0 +1,106 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "reading.h"
+#include "util.h"
+#include "wordindex.h"
+
+/* Report the round-start latency of wheel: the time from the player choosing
+   a word length to the list of candidate word indexes being ready.
+
+   The "prune" column is the former path, which scanned the whole dictionary
+   with strlen and grew the word list with one realloc per matching word.
+   The "bucket" column looks up the length's group in the word index, a view
+   of the range of the dictionary bucketed by length at load time.
+
+   Usage: roundbench [dictionary]
+
+   To compile the program:
+          make roundbench
+*/
+
+#define REPEATS 20
+
+/* The former prune_word_list: the words of dict of length len, NULL-terminated. */
+char **prune_word_list(struct dictionary *dict, int len, int *words_remaining) {
+    char **target_words = NULL;
+    int counter = 0;
+    for (int i = 0; i < dict->num_words; i++) {
+        char *word = get_word(dict, i);
+        if (strlen(word) == len) {
+            counter++;
+            target_words = realloc(target_words, sizeof(char *) * (1 + counter));
+            if (target_words == NULL) {
+                perror("realloc");
+                exit(1);
+            }
+            target_words[counter - 1] = word;
+            target_words[counter] = NULL;
+        }
+    }
+    *words_remaining = counter;
+    return target_words;
+}
+
+/* Return the candidate indexes 0 .. n - 1 of a new round. */
+int *start_ids(int n) {
+    int *ids = malloc((n > 0 ? n : 1) * sizeof(int));
+    if (ids == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+    for (int i = 0; i < n; i++) {
+        ids[i] = i;
+    }
+    return ids;
+}
+
+int main(int argc, char **argv) {
+    if (argc > 2) {
+        fprintf(stderr, "Usage: %s [dictionary]\n", argv[0]);
+        exit(1);
+    }
+    struct dictionary *dict = load_dictionary(argc == 2 ? argv[1] : DICTIONARY);
+    struct word_index *index = build_word_index(dict);
+
+    printf("%6s %8s %12s %12s %8s\n", "length", "words", "prune us", "bucket us", "speedup");
+    for (int len = 1; len <= index->max_length; len++) {
+        struct word_group *group = get_word_group(index, len);
+        if (group == NULL) {
+            continue;
+        }
+
+        double prune = 0, bucket = 0;
+        for (int r = 0; r < REPEATS; r++) {
+            int n;
+            long start = now_ns();
+            char **word_list = prune_word_list(dict, len, &n);
+            int *ids = start_ids(n);
+            double t = (now_ns() - start) / 1e9;
+            free(word_list);
+            free(ids);
+            if (r == 0 || t < prune) {
+                prune = t;
+            }
+
+            start = now_ns();
+            struct word_group *g = get_word_group(index, len);
+            ids = start_ids(g->num_words);
+            t = (now_ns() - start) / 1e9;
+            free(ids);
+            if (r == 0 || t < bucket) {
+                bucket = t;
+            }
+            if (g->num_words != n) {
+                fprintf(stderr, "Length %d: %d words in the group, %d pruned\n", len, g->num_words, n);
+                exit(1);
+            }
+        }
+        printf("%6d %8d %12.1f %12.1f %7.0fx\n", len, group->num_words, prune * 1e6,
+               bucket * 1e6, prune / bucket);
+    }
+
+    deallocate_word_index(index);
+    deallocate_dictionary(dict);
+    return 0;
+}
@@ -0,0 +1,66 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "trace.h"
+
+/* Size of a tracer's output buffer; lines are flushed in blocks of this. */
+#define TRACE_BUFFER (1 << 16)
+
+const char *phase_names[NUM_PHASES] = {
+    "stats", "lookahead", "book", "materialize", "partition", "keep"
+};
+
+
+/* Create the trace file filename, write its header line and return a
+   tracer writing to it.
+*/
+struct tracer *open_tracer(char *filename) {
+    struct tracer *tracer = malloc(sizeof(struct tracer));
+    if (tracer == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+    tracer->fp = fopen(filename, "w");
+    if (tracer->fp == NULL) {
+        perror(filename);
+        exit(1);
+    }
+    setvbuf(tracer->fp, NULL, _IOFBF, TRACE_BUFFER);
+    fputs(TRACE_COLUMNS, tracer->fp);
+    for (int p = 0; p < NUM_PHASES; p++) {
+        fprintf(tracer->fp, ",%s_ns", phase_names[p]);
+    }
+    fprintf(tracer->fp, ",total_ns\n");
+    return tracer;
+}
+
+
+/* Write one guess to the trace. The line is formatted first and written
+   with one call, which stdio locks, so threads never interleave lines.
+*/
+void write_guess_trace(struct tracer *tracer, struct guess_trace *trace) {
+    char line[512];
+    long total = 0;
+    int len = snprintf(line, sizeof(line), "%d,%c,%d,%d,%d,%d,%ld,%zu,%ld", trace->length,
+                       trace->letter, trace->candidates, trace->kept, trace->families,
+                       trace->biggest, trace->words_scanned, trace->arena_bytes,
+                       trace->lookahead_nodes);
+    for (int p = 0; p < NUM_PHASES; p++) {
+        len += snprintf(line + len, sizeof(line) - len, ",%ld", trace->phase_ns[p]);
+        total += trace->phase_ns[p];
+    }
+    len += snprintf(line + len, sizeof(line) - len, ",%ld\n", total);
+    if (fputs(line, tracer->fp) == EOF) {
+        perror("fputs");
+        exit(1);
+    }
+}
+
+
+/* Flush and close the trace file and deallocate the tracer. */
+void close_tracer(struct tracer *tracer) {
+    if (fclose(tracer->fp) != 0) {
+        perror("fclose");
+        exit(1);
+    }
+    free(tracer);
+}
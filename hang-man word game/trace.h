@@ -0,0 +1,54 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+/* Environment variable naming the trace file of programs that trace guesses. */
+#define TRACE_ENV "HANGMAN_TRACE"
+
+/* The steps of a guess that a trace times. */
+enum guess_phase {
+    PHASE_STATS, /* get_letter_stats, for guessers that use it */
+    PHASE_LOOKAHEAD, /* choose_family */
+    PHASE_BOOK, /* Answering from the opening book */
+    PHASE_MATERIALIZE, /* Rebuilding the candidates on leaving the book */
+    PHASE_PARTITION, /* Splitting the candidates into families */
+    PHASE_KEEP, /* Shrinking the candidates to the kept family */
+    NUM_PHASES
+};
+
+/* The columns of a trace line before the phase times; then comes one
+   <phase>_ns column per phase, named by phase_names, and total_ns. */
+#define TRACE_COLUMNS "length,letter,candidates,kept,families,biggest,words_scanned," \
+                      "arena_bytes,lookahead_nodes"
+
+/* Names of the phases, as CSV column prefixes. */
+extern const char *phase_names[NUM_PHASES];
+
+/* What one guess of a round cost. */
+struct guess_trace {
+    int length; /* Word length of the game */
+    char letter; /* The letter guessed */
+    int candidates; /* Candidates before the guess */
+    int kept; /* Candidates after it */
+    int families; /* Families the candidates were split into; 0 if from the book */
+    int biggest; /* Words in the biggest family */
+    long words_scanned; /* Words read by all phases */
+    size_t arena_bytes; /* Most scratch memory in use at once */
+    long lookahead_nodes; /* Positions the lookahead searched */
+    long phase_ns[NUM_PHASES]; /* Time spent in each phase */
+};
+
+/* A trace file of guesses, one CSV line per guess. Rounds on any number of
+   threads may write to one tracer; each line is written whole.
+*/
+struct tracer {
+    FILE *fp;
+};
+
+struct tracer *open_tracer(char *filename);
+void write_guess_trace(struct tracer *tracer, struct guess_trace *trace);
+void close_tracer(struct tracer *tracer);
+
+#endif
@@ -0,0 +1,169 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "trace.h"
+#include "util.h"
+
+/* This program summarizes a guess trace written by wheel or evilsim (with
+ * -T or the HANGMAN_TRACE environment variable). For every word length it
+ * prints the number of guesses, percentiles of the time per guess, the mean
+ * time of each phase, the mean words scanned and families, the biggest
+ * family and the mean scratch memory, so the slow lengths stand out.
+ *
+ *   tracesum [trace file]   (default: standard input)
+ *
+ * To compile the program:
+ *          make tracesum
+ */
+
+#define LINE_SIZE 512
+
+/* Longest word length a trace line may have. */
+#define MAX_TRACE_LENGTH 4096
+
+/* The guesses of one word length. */
+struct length_summary {
+    long num_guesses;
+    long max_guesses; /* Number of guesses total_ns has room for */
+    long *total_ns; /* Time of each guess */
+    double phase_ns[NUM_PHASES]; /* Sums over the guesses */
+    double words_scanned;
+    double families;
+    double arena_bytes;
+    int biggest; /* Biggest family of any guess */
+};
+
+
+/* Return 1 if line is the header open_tracer writes: TRACE_COLUMNS, a
+   column for each phase of phase_names in order, and total_ns.
+*/
+static int is_trace_header(char *line) {
+    char header[LINE_SIZE];
+    int len = snprintf(header, sizeof(header), "%s", TRACE_COLUMNS);
+    for (int p = 0; p < NUM_PHASES; p++) {
+        len += snprintf(header + len, sizeof(header) - len, ",%s_ns", phase_names[p]);
+    }
+    snprintf(header + len, sizeof(header) - len, ",total_ns\n");
+    return strcmp(line, header) == 0;
+}
+
+
+/* Parse a trace line into trace and *total. Return 1 on success, or 0 if
+   the line does not have every column of the header.
+*/
+static int parse_trace_line(char *line, struct guess_trace *trace, long *total) {
+    int pos;
+    if (sscanf(line, "%d,%c,%d,%d,%d,%d,%ld,%zu,%ld%n", &trace->length, &trace->letter,
+               &trace->candidates, &trace->kept, &trace->families, &trace->biggest,
+               &trace->words_scanned, &trace->arena_bytes, &trace->lookahead_nodes, &pos) != 9) {
+        return 0;
+    }
+    line += pos;
+    for (int p = 0; p < NUM_PHASES; p++) {
+        if (sscanf(line, ",%ld%n", &trace->phase_ns[p], &pos) != 1) {
+            return 0;
+        }
+        line += pos;
+    }
+    return sscanf(line, ",%ld%n", total, &pos) == 1 && strcmp(line + pos, "\n") == 0;
+}
+
+
+/* Return the p-th percentile of the n sorted values. */
+static long percentile(long *values, long n, double p) {
+    long i = (long) (p * n);
+    return values[i < n ? i : n - 1];
+}
+
+
+int main(int argc, char *argv[]) {
+    FILE *fp = stdin;
+    if (argc > 2) {
+        fprintf(stderr, "Usage: tracesum [trace file]\n");
+        exit(1);
+    }
+    if (argc == 2 && (fp = fopen(argv[1], "r")) == NULL) {
+        perror(argv[1]);
+        exit(1);
+    }
+
+    char line[LINE_SIZE];
+    if (fgets(line, LINE_SIZE, fp) == NULL || strncmp(line, "length,", 7) != 0) {
+        fprintf(stderr, "tracesum: not a guess trace\n");
+        exit(1);
+    }
+    if (!is_trace_header(line)) {
+        fprintf(stderr, "tracesum: the trace's columns do not match this tracesum: %s", line);
+        exit(1);
+    }
+    int num_lengths = 0; /* Lengths lengths has room for */
+    struct length_summary *lengths = NULL;
+    while (fgets(line, LINE_SIZE, fp) != NULL) {
+        struct guess_trace trace;
+        long total;
+        if (!parse_trace_line(line, &trace, &total) || trace.length < 0
+            || trace.length > MAX_TRACE_LENGTH) {
+            fprintf(stderr, "tracesum: bad line: %s", line);
+            exit(1);
+        }
+        if (trace.length >= num_lengths) {
+            lengths = realloc(lengths, (trace.length + 1) * sizeof(struct length_summary));
+            if (lengths == NULL) {
+                perror("realloc");
+                exit(1);
+            }
+            memset(lengths + num_lengths, 0,
+                   (trace.length + 1 - num_lengths) * sizeof(struct length_summary));
+            num_lengths = trace.length + 1;
+        }
+        struct length_summary *sum = &lengths[trace.length];
+        if (sum->num_guesses == sum->max_guesses) {
+            sum->max_guesses = sum->max_guesses > 0 ? 2 * sum->max_guesses : 1024;
+            sum->total_ns = realloc(sum->total_ns, sum->max_guesses * sizeof(long));
+            if (sum->total_ns == NULL) {
+                perror("realloc");
+                exit(1);
+            }
+        }
+        sum->total_ns[sum->num_guesses++] = total;
+        for (int p = 0; p < NUM_PHASES; p++) {
+            sum->phase_ns[p] += trace.phase_ns[p];
+        }
+        sum->words_scanned += trace.words_scanned;
+        sum->families += trace.families;
+        sum->arena_bytes += trace.arena_bytes;
+        if (trace.biggest > sum->biggest) {
+            sum->biggest = trace.biggest;
+        }
+    }
+    if (fp != stdin) {
+        fclose(fp);
+    }
+
+    // The phase columns are the mean time of each phase per guess.
+    printf("%6s %9s %9s %9s %9s %10s", "length", "guesses", "p50 ns", "p90 ns", "p99 ns",
+           "max ns");
+    for (int p = 0; p < NUM_PHASES; p++) {
+        printf(" %11s", phase_names[p]);
+    }
+    printf(" %9s %8s %8s %10s\n", "scanned", "families", "biggest", "arena");
+    for (int len = 0; len < num_lengths; len++) {
+        struct length_summary *sum = &lengths[len];
+        long n = sum->num_guesses;
+        if (n == 0) {
+            continue;
+        }
+        qsort(sum->total_ns, n, sizeof(long), compare_longs);
+        printf("%6d %9ld %9ld %9ld %9ld %10ld", len, n, percentile(sum->total_ns, n, 0.5),
+               percentile(sum->total_ns, n, 0.9), percentile(sum->total_ns, n, 0.99),
+               sum->total_ns[n - 1]);
+        for (int p = 0; p < NUM_PHASES; p++) {
+            printf(" %11.0f", sum->phase_ns[p] / n);
+        }
+        printf(" %9.0f %8.1f %8d %10.0f\n", sum->words_scanned / n, sum->families / n,
+               sum->biggest, sum->arena_bytes / n);
+        free(sum->total_ns);
+    }
+    free(lengths);
+    return 0;
+}
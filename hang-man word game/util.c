@@ -0,0 +1,37 @@
+#include <time.h>
+#include "util.h"
+
+/* The splitmix64 increment, the golden ratio in 64 bits. */
+#define GOLDEN_GAMMA 0x9e3779b97f4a7c15ULL
+
+
+/* Return the current monotonic time in nanoseconds. */
+long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+
+/* Return a well-mixed 64-bit value derived from x (splitmix64). */
+uint64_t mix64(uint64_t x) {
+    x += GOLDEN_GAMMA;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+
+/* Return the next number of the splitmix64 generator with state *state. */
+uint64_t next_random(uint64_t *state) {
+    uint64_t z = mix64(*state);
+    *state += GOLDEN_GAMMA;
+    return z;
+}
+
+
+/* Compare two longs for qsort. */
+int compare_longs(const void *a, const void *b) {
+    long x = *(const long *) a, y = *(const long *) b;
+    return (x > y) - (x < y);
+}
@@ -0,0 +1,13 @@
+#ifndef UTIL_H
+#define UTIL_H
+
+#include <stdint.h>
+
+/* Small helpers shared by the engine, its tools and the benchmarks. */
+
+long now_ns(void);
+uint64_t mix64(uint64_t x);
+uint64_t next_random(uint64_t *state);
+int compare_longs(const void *a, const void *b);
+
+#endif
@@ -1,64 +1,21 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include "book.h"
 #include "family.h"
+#include "lookahead.h"
+#include "pool.h"
 #include "reading.h"
+#include "round.h"
+#include "wordindex.h"
 
 #define BUF_SIZE	256
 
-/* Starting with words (returned by read_words), generate and return
-   a new word list with only those words of length len. Also, fill
-   words_remaining with the number of words in the new word list.
-
-   Allocate exactly enough memory to store only those words of length len.
-
-   Note: Do not make copies of the words.
-*/
-char **prune_word_list(char **words, int len, int *words_remaining) {
-     /*
-      * Initial a pointer to the list collecting words with length of input len
-      * and a counter counting the number of words in the aforementioned list.
-      */
-    char **target_words = NULL;
-    int counter = 0;
-
-
-    /*
-     * loop through every word in the dictionary and append the list target_words with each
-     * word with the length of len.
-     */
-    for(int i =0; words[i] != NULL; i++){
-        if(strlen(words[i]) == len){
-            counter++;
-            target_words = realloc(target_words, sizeof(char*)*(1+ counter));
-            //check the error of reallocating memory.
-            if(target_words == NULL){
-                perror("error: reallocating memory of prune list\n");
-                exit(1);
-            }
-
-            target_words[counter -1] = words[i];
-            target_words[counter] = NULL;
-        }
-    }
-
-    //fill words_remaining with the number of words in the list target_word.
-    *words_remaining = counter;
-
-    return target_words;
-}
-
-
-/* Free memory acquired by prune_word_list.
-*/
-void deallocate_pruned_word_list(char **word_list) {
-    free(word_list);
-}
-
-
-/* Return the word_list of all length-L words, and store that length in len.
+/* Return the group of all length-L words, and store that length in len.
    - ask user for the length of words to use
-   - use prune_word_list to get a list of words of the appropriate length
+   - look up the group of words of that length in index; the dictionary is
+    bucketed by length when it is loaded, so this neither scans nor copies
    - if there are no words of this length in word list, then ask user to
     provide a different word length until there is at least one word of that
     length in words.
@@ -71,20 +28,18 @@ void deallocate_pruned_word_list(char **word_list) {
     printf("Length of words to use? ");
     printf("There are no words of that length.\n");
 */
-char **get_word_list_of_length(char **words, int *len) {
+struct word_group *get_word_group_of_length(struct word_index *index, int *len) {
     /*
      * Initialize the address of a string representing the input.
      * Initialize an integer representing the length of the word.
-     * Initialize an integer representing the number of the words in the prune list.
-     * Initialize the prune list.
+     * Initialize the group of words of that length.
      */
     char input[BUF_SIZE];
     int word_length;
-    int words_remaining = 0;
-    char **prune_list;
+    struct word_group *group = NULL;
 
 
-    // Find the prune word list.
+    // Find the group of words.
     do {
         printf("Length of words to use? ");
         //Checking whether fgets() gets the length of words to be found.
@@ -94,28 +49,23 @@ char **get_word_list_of_length(char **words, int *len) {
         }else {
             //convert the input into an integer.
             word_length = strtol(input, NULL, 10);
-            /*
-             * If the word length is smaller than 1 or bigger than MAX_WORD_LENGHT or non-numeric,
-             * there are no words of that length.
-             */
-            if(word_length <= 0 || word_length > MAX_WORD_LENGTH){
+            // get_word_group returns NULL for lengths with no words, including non-positive ones.
+            // Words too long for signature masks cannot be played.
+            group = word_length > 0 ? get_word_group(index, word_length) : NULL;
+            if (group != NULL && !has_signatures(group)) {
+                group = NULL;
+            }
+            if (group == NULL) {
                 printf("There are no words of that length.\n");
-            }else {
-                //find the prune word list by calling the function prune_word_list
-                prune_list = prune_word_list(words, word_length, &words_remaining);
-                // if words_remaining is 0, then it also means that there are no words of that length.
-                if (words_remaining == 0) {
-                    printf("There are no words of that length.\n");
-                }
             }
         }
-        // If prune word list containing at least 1 word can not be found, then require a player to input again.
-    }while(words_remaining == 0);
+        // If a group containing at least 1 word can not be found, then require a player to input again.
+    }while(group == NULL);
 
     // Fill len with word_length
     *len = word_length;
 
-    return prune_list;
+    return group;
 }
 
 
@@ -153,21 +103,24 @@ char get_next_guess(char *letters_guessed) {
 }
 
 
-/*Play one game of Wheel of Misfortune */
-void play_round(char **words) {
-    Family *famlist = NULL, *biggest_fam;
+/*Play one game of Wheel of Misfortune. round holds all the memory
+  the game needs, so nothing is allocated while playing. If la is not NULL,
+  it chooses the family to keep after each guess instead of the biggest.*/
+void play_round(struct word_index *index, struct round *round, struct lookahead *la) {
     char input_buffer[BUF_SIZE];
-    char **word_list = NULL;
-    int len, i, found;
+    struct word_group *group;
+    int len;
     int guesses = 0;
     int game_over = 0; /*1 = game is over*/
     char guess;
-    char *current_word; /*Representation of current word; each blank is a - */
-    char *sig; /*Signature of a family*/
     char letters_guessed[26] = {'\0'}; /*Guesses so far*/
     
-    /*Get a valid word_list from length (one that has at least one word)*/
-    word_list = get_word_list_of_length(words, &len);
+    /*Get a valid group from length (one that has at least one word)*/
+    group = get_word_group_of_length(index, &len);
+
+    /*The remaining words are tracked by their indexes in the group of
+      length-len words, whose mask index gives their signatures.*/
+    start_round(round, group);
 
     while (guesses < 1 || guesses > 26) {
         printf("How many guesses would you like?\n");
@@ -185,40 +138,24 @@ void play_round(char **words) {
 	}
     }
 
-    /*Word starts off as all unknowns*/
-    current_word = malloc(len + 1);
-    if (current_word == NULL) {
-        perror("malloc");
-        exit(1);
-    }
-    memset(current_word, '-', len);
-    current_word[len] = '\0';
-
     while (!game_over) {
         printf("Guesses remaining: %d\n", guesses);
-        printf("Word: %s\n", current_word);
+        /*The pattern starts off as all unknowns and is revealed by partition_round*/
+        printf("Word: %s\n", round->pattern);
         guess = get_next_guess(letters_guessed);
-        deallocate_families(famlist);
-        famlist = generate_families(word_list, guess);
-        biggest_fam = find_biggest_family(famlist);
-        
-        sig = get_family_signature(biggest_fam);
-        
-        /*Search signature for letters in current_word*/
-        found = 0;
-        i = 0;
-        while (*sig) {
-            if (*sig == guess) {
-                found = 1;
-                current_word[i] = guess;
-            }
-            sig++;
-            i++;
+        /*Keep the biggest family, or the one the lookahead adversary picks;
+          a nonzero mask means it has the letter*/
+        uint64_t mask;
+        if (la != NULL) {
+            mask = choose_family(la, round, letters_guessed, guess, guesses);
+            mask = partition_round_keep(round, guess, mask);
+        } else {
+            mask = partition_round(round, guess);
         }
-        if (found) {
+        if (mask != 0) {
             printf("Good guess!\n");
-            if (!strchr(current_word, '-')) {
-                printf("You win! The word was %s.\n", current_word);
+            if (!strchr(round->pattern, '-')) {
+                printf("You win! The word was %s.\n", round->pattern);
                 game_over = 1;
             }
         }
@@ -227,32 +164,77 @@ void play_round(char **words) {
             guesses--;
             game_over = guesses <= 0;
         }
-        deallocate_pruned_word_list(word_list);
-        word_list = get_new_word_list(biggest_fam);
     }
 
     if (guesses == 0) {
         printf("You lose! The word was %s.\n",
-                get_random_word_from_family(biggest_fam));
+                get_random_round_word(round));
     }
-    
-    deallocate_pruned_word_list(word_list);
-    free(current_word);
-    deallocate_families(famlist);
 }
 
 
 /* Read words, initialize families, and play as long as
-   the user answers 'y'. */
-int main(void) {
+   the user answers 'y'. The dictionary, a text file or an image compiled
+   by mkdict, may be given as the only argument. With -l ms, the adversary
+   looks ahead for up to ms milliseconds per guess. */
+int main(int argc, char **argv) {
     char again;
-    char **words;
+    struct dictionary *dict;
+    struct word_index *index;
+    struct round round;
+    struct lookahead lookahead;
+    struct pool pool;
+    struct book *book = NULL;
+    char *book_name = NULL;
+    char *trace_name = getenv(TRACE_ENV);
+    struct tracer *tracer = NULL;
+    long budget_ms = 0;
+    long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int ch;
     
-    words = read_words("dictionary.txt");
+    while ((ch = getopt(argc, argv, "l:b:T:")) != -1) {
+        switch (ch) {
+        case 'l':
+            budget_ms = strtol(optarg, NULL, 10);
+            break;
+        case 'b':
+            book_name = optarg;
+            break;
+        case 'T':
+            trace_name = optarg;
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-l ms] [-b book] [-T trace] [dictionary]\n", argv[0]);
+            exit(1);
+        }
+    }
+    if (argc - optind > 1 || budget_ms < 0) {
+        fprintf(stderr, "Usage: %s [-l ms] [-b book] [-T trace] [dictionary]\n", argv[0]);
+        exit(1);
+    }
+    dict = load_dictionary(argc - optind == 1 ? argv[optind] : DICTIONARY);
+    index = build_word_index(dict);
     init_family(1024);    
+    init_round(&round, index);
+    if (book_name != NULL) {
+        book = load_book(book_name, index);
+        set_round_book(&round, book);
+    }
+    if (trace_name != NULL && *trace_name != '\0') {
+        tracer = open_tracer(trace_name);
+        set_round_tracer(&round, tracer);
+    }
+    // Long words have few candidates; short ones can have tens of thousands.
+    if (num_cpus > 1) {
+        init_pool(&pool, num_cpus);
+        set_round_pool(&round, &pool);
+    }
+    if (budget_ms > 0) {
+        init_lookahead(&lookahead, index, budget_ms * 1000000);
+    }
 
     do {
-        play_round(words);
+        play_round(index, &round, budget_ms > 0 ? &lookahead : NULL);
         printf("Play another round (y/n)? ");
         if (scanf(" %c", &again) != 1) {
             perror("scanf");
@@ -263,6 +245,20 @@ int main(void) {
 
     } while (again == 'y');
   
-    deallocate_words(words);
+    if (budget_ms > 0) {
+        deallocate_lookahead(&lookahead);
+    }
+    deallocate_round(&round);
+    if (book != NULL) {
+        deallocate_book(book);
+    }
+    if (tracer != NULL) {
+        close_tracer(tracer);
+    }
+    if (num_cpus > 1) {
+        deallocate_pool(&pool);
+    }
+    deallocate_word_index(index);
+    deallocate_dictionary(dict);
     return 0;
 }
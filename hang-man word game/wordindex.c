@@ -0,0 +1,254 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "family.h"
+#include "reading.h"
+#include "wordindex.h"
+
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_LANES
+#endif
+
+
+/* Set column[w] to the signature mask for letter of the word in lane w of
+   lanes, for every word w = ids[i], 0 <= i < n.
+*/
+static void lane_column_scalar(const char *lanes, char letter, const int *ids, int n,
+                               uint64_t *column) {
+    for (int i = 0; i < n; i++) {
+        const char *lane = lanes + (size_t) ids[i] * WORD_LANE;
+        uint64_t mask = 0;
+        for (int j = 0; j < WORD_LANE && lane[j] != '\0'; j++) {
+            if (lane[j] == letter) {
+                mask |= (uint64_t) 1 << j;
+            }
+        }
+        column[ids[i]] = mask;
+    }
+}
+
+#ifdef HAVE_X86_LANES
+/* As lane_column_scalar, with two 16-byte compares per word. */
+static void lane_column_sse2(const char *lanes, char letter, const int *ids, int n,
+                             uint64_t *column) {
+    __m128i pattern = _mm_set1_epi8(letter);
+    for (int i = 0; i < n; i++) {
+        const char *lane = lanes + (size_t) ids[i] * WORD_LANE;
+        __m128i lo = _mm_load_si128((const __m128i *) lane);
+        __m128i hi = _mm_load_si128((const __m128i *) (lane + 16));
+        column[ids[i]] = (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(lo, pattern))
+            | (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(hi, pattern)) << 16;
+    }
+}
+
+/* As lane_column_scalar, with one 32-byte compare per word. */
+__attribute__((target("avx2")))
+static void lane_column_avx2(const char *lanes, char letter, const int *ids, int n,
+                             uint64_t *column) {
+    __m256i pattern = _mm256_set1_epi8(letter);
+    for (int i = 0; i < n; i++) {
+        const char *lane = lanes + (size_t) ids[i] * WORD_LANE;
+        __m256i word = _mm256_load_si256((const __m256i *) lane);
+        column[ids[i]] = (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(word, pattern));
+    }
+}
+#endif
+
+/* The fastest of the above this CPU runs; set by build_word_index. */
+static void (*lane_column)(const char *lanes, char letter, const int *ids, int n,
+                           uint64_t *column) = lane_column_scalar;
+
+
+/* Pick the lane_column this CPU supports. */
+static void choose_lane_column(void) {
+#ifdef HAVE_X86_LANES
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        lane_column = lane_column_avx2;
+    } else if (__builtin_cpu_supports("sse2")) {
+        lane_column = lane_column_sse2;
+    }
+#endif
+}
+
+
+/* Pack the words of group into its lanes. */
+static void build_lanes(struct word_group *group) {
+    size_t size = (size_t) WORD_LANE * (group->num_words > 0 ? group->num_words : 1);
+    if (posix_memalign((void **) &group->lanes, WORD_LANE, size) != 0) {
+        perror("posix_memalign");
+        exit(1);
+    }
+    memset(group->lanes, 0, size);
+    for (int i = 0; i < group->num_words; i++) {
+        memcpy(group->lanes + (size_t) i * WORD_LANE, group->words[i], group->length);
+    }
+}
+
+
+/* Fill the mask columns of group from its words. */
+static void build_masks(struct word_group *group) {
+    int n = group->num_words;
+    group->masks = calloc((size_t) NUM_LETTERS * (n > 0 ? n : 1), sizeof(uint64_t));
+    if (group->masks == NULL) {
+        perror("calloc");
+        exit(1);
+    }
+    for (int i = 0; i < n; i++) {
+        char *word = group->words[i];
+        for (int j = 0; j < group->length; j++) {
+            if (word[j] >= 'a' && word[j] <= 'z') {
+                group->masks[(size_t) (word[j] - 'a') * n + i] |= (uint64_t) 1 << j;
+            }
+        }
+    }
+}
+
+
+/* Build and return the index of the words of dict: the words grouped by
+   length, each group with its mask columns, or with only its lanes if packed
+   is 1 and the words fit in them.
+   The dictionary is already bucketed by length, so each group is a range of
+   one pointer array in dictionary order; the words are not copied, except
+   into the lanes of the groups of short words of a packed index.
+   A dictionary image that carries mask columns lends them to the index, and
+   then no lanes are built.
+*/
+static struct word_index *build_index(struct dictionary *dict, int packed) {
+    struct word_index *index = malloc(sizeof(struct word_index));
+    if (index == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+
+    choose_lane_column();
+    index->max_length = dict->max_length;
+    index->groups = calloc(index->max_length + 1, sizeof(struct word_group));
+    index->words = malloc((dict->num_words + 1) * sizeof(char *));
+    if (index->groups == NULL || index->words == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+    for (int i = 0; i < dict->num_words; i++) {
+        index->words[i] = get_word(dict, i);
+    }
+
+    // The mask columns of an image line up with the buckets, as do the groups.
+    index->shared_masks = dict->masks != NULL;
+    for (int len = 0; len <= index->max_length; len++) {
+        struct word_group *group = &index->groups[len];
+        group->length = len;
+        group->num_words = get_words_of_length(dict, len, &group->first);
+        group->words = index->words + group->first;
+        if (len > MAX_SIGNATURE_BITS) {
+            continue;
+        }
+        if (index->shared_masks) {
+            group->masks = dict->masks + (size_t) NUM_LETTERS * group->first;
+        } else if (packed && len <= WORD_LANE) {
+            build_lanes(group);
+        } else {
+            build_masks(group);
+        }
+    }
+    return index;
+}
+
+
+/* Build and return the index of the words of dict, with mask columns for
+   every length up to MAX_SIGNATURE_BITS.
+*/
+struct word_index *build_word_index(struct dictionary *dict) {
+    return build_index(dict, 0);
+}
+
+
+/* Build and return the index of the words of dict, keeping the words of up
+   to WORD_LANE letters only in lanes: signatures are then computed when
+   needed (see get_candidate_column) and the index takes WORD_LANE bytes per
+   word instead of NUM_LETTERS * 8. Mask columns of an image are still used.
+*/
+struct word_index *build_packed_word_index(struct dictionary *dict) {
+    return build_index(dict, 1);
+}
+
+
+/* Return 1 if games can be played over group: its signatures are either
+   in mask columns or can be computed from lanes.
+*/
+int has_signatures(struct word_group *group) {
+    return group->masks != NULL || group->lanes != NULL;
+}
+
+
+/* Return the group of words of the given length, or NULL if there are none. */
+struct word_group *get_word_group(struct word_index *index, int length) {
+    if (length < 0 || length > index->max_length || index->groups[length].num_words == 0) {
+        return NULL;
+    }
+    return &index->groups[length];
+}
+
+
+/* Return the column of masks of group for letter: element i is the
+   signature mask of word i of the group for letter.
+*/
+uint64_t *get_letter_column(struct word_group *group, char letter) {
+    return group->masks + (size_t) (letter - 'a') * group->num_words;
+}
+
+
+/* Return a column of signature masks of group for letter that is valid for
+   the words ids[0], ..., ids[n - 1]: element w is the signature of word w.
+   That is the group's mask column if it has one; otherwise the signatures
+   of those words are computed from their lanes, one vector compare each,
+   into scratch, which has room for every word of the group.
+*/
+uint64_t *get_candidate_column(struct word_group *group, char letter, const int *ids, int n,
+                               uint64_t *scratch) {
+    if (group->masks != NULL) {
+        return get_letter_column(group, letter);
+    }
+    lane_column(group->lanes, letter, ids, n, scratch);
+    return scratch;
+}
+
+
+/* Set masks[c] to the signature mask of word i of group for letter 'a' + c,
+   for every letter c in the set letters (bit c for 'a' + c) that the word
+   contains, and return the set of those letters; the other entries of masks
+   are not set.
+*/
+uint32_t get_word_signatures(struct word_group *group, int i, uint32_t letters,
+                             uint64_t masks[NUM_LETTERS]) {
+    const char *word = group->lanes != NULL ? group->lanes + (size_t) i * WORD_LANE : group->words[i];
+    uint32_t present = 0;
+    for (int j = 0; j < group->length; j++) {
+        int c = word[j] - 'a';
+        if (c < 0 || c >= NUM_LETTERS || !(letters & ((uint32_t) 1 << c))) {
+            continue;
+        }
+        if (!(present & ((uint32_t) 1 << c))) {
+            present |= (uint32_t) 1 << c;
+            masks[c] = 0;
+        }
+        masks[c] |= (uint64_t) 1 << j;
+    }
+    return present;
+}
+
+
+/* Deallocate the index; the words it points to are not freed. */
+void deallocate_word_index(struct word_index *index) {
+    for (int len = 0; len <= index->max_length; len++) {
+        if (!index->shared_masks) {
+            free(index->groups[len].masks);
+        }
+        free(index->groups[len].lanes);
+    }
+    free(index->words);
+    free(index->groups);
+    free(index);
+}
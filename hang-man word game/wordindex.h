@@ -0,0 +1,58 @@
+#ifndef WORDINDEX_H
+#define WORDINDEX_H
+
+#include <stdint.h>
+
+/* Number of letters a word can be guessed by. */
+#define NUM_LETTERS 26
+
+/* Words of up to WORD_LANE letters are also packed into lanes of WORD_LANE
+   bytes, so a word's signature for a letter is one vector compare. */
+#define WORD_LANE 32
+
+/* All words of one length, with a letter-position mask index over them.
+   The group is a view of the dictionary's bucket for that length:
+   word i of the group is word first + i of the dictionary.
+
+   masks is laid out as NUM_LETTERS columns of num_words masks each:
+   bit j of masks[(letter - 'a') * num_words + i] is set if words[i][j] is letter.
+   Partitioning by a letter therefore reads one contiguous column of integers.
+   masks is NULL for words longer than MAX_SIGNATURE_BITS, and for words
+   that only have lanes in a packed index.
+
+   lanes holds the text of word i, NUL-padded, at lanes[i * WORD_LANE], so
+   the words are read in order from one array instead of through pointers.
+   Only a packed index has lanes, in place of the masks of words of up to
+   WORD_LANE letters; lanes is NULL everywhere else.
+*/
+struct word_group {
+    int length; /* Length of every word in the group */
+    int first; /* Index in the dictionary of the first word of the group */
+    int num_words; /* Number of words in the group */
+    char **words; /* The words; word i of the group is words[i] */
+    uint64_t *masks; /* NUM_LETTERS columns of num_words position masks */
+    char *lanes; /* num_words lanes of WORD_LANE bytes */
+};
+
+/* The words of a dictionary grouped by length. */
+struct word_index {
+    int max_length; /* Length of the longest word */
+    int shared_masks; /* 1 if the mask columns belong to a mapped dictionary image */
+    char **words; /* Pointers to all words of the dictionary, in its order */
+    struct word_group *groups; /* groups[len] holds the words of length len */
+};
+
+struct dictionary;
+
+struct word_index *build_word_index(struct dictionary *dict);
+struct word_index *build_packed_word_index(struct dictionary *dict);
+int has_signatures(struct word_group *group);
+struct word_group *get_word_group(struct word_index *index, int length);
+uint64_t *get_letter_column(struct word_group *group, char letter);
+uint64_t *get_candidate_column(struct word_group *group, char letter, const int *ids, int n,
+                               uint64_t *scratch);
+uint32_t get_word_signatures(struct word_group *group, int i, uint32_t letters,
+                             uint64_t masks[NUM_LETTERS]);
+void deallocate_word_index(struct word_index *index);
+
+#endif
@@ -4,58 +4,171 @@
 #include <stdlib.h>
 #include <string.h>
 #include <getopt.h>
+#include <stdint.h>
 #include "helper.h"
+#include "simdsort.h"
 
 
-int get_file_size(char *filename) {
-    struct stat sbuf;
+/*
+ * Define a comparator for keys of type at the given byte offset into a record.
+ * sign is 1 for ascending order and -1 for descending order. With a constant offset
+ * and sign the key loads and the comparison compile down to a few instructions.
+ */
+#define DEFINE_KEY_COMPARE(name, type, offset, sign)                        \
+    static int name(const void *rec1, const void *rec2) {                  \
+        type key1, key2;                                                    \
+        memcpy(&key1, (const char *) rec1 + (offset), sizeof(type));        \
+        memcpy(&key2, (const char *) rec2 + (offset), sizeof(type));        \
+        return (sign) * ((key1 > key2) - (key1 < key2));                    \
+    }
 
-    if ((stat(filename, &sbuf)) == -1) {
-       perror("stat");
-       exit(1);
+/* Specialized kernels for the common layouts: the key leads the record. */
+DEFINE_KEY_COMPARE(compare_i32_asc, int32_t, 0, 1)
+DEFINE_KEY_COMPARE(compare_i32_desc, int32_t, 0, -1)
+DEFINE_KEY_COMPARE(compare_u32_asc, uint32_t, 0, 1)
+DEFINE_KEY_COMPARE(compare_u32_desc, uint32_t, 0, -1)
+DEFINE_KEY_COMPARE(compare_i64_asc, int64_t, 0, 1)
+DEFINE_KEY_COMPARE(compare_i64_desc, int64_t, 0, -1)
+DEFINE_KEY_COMPARE(compare_u64_asc, uint64_t, 0, 1)
+DEFINE_KEY_COMPARE(compare_u64_desc, uint64_t, 0, -1)
+
+/* Generic kernels for keys anywhere else in the record; still typed, not byte-wise. */
+DEFINE_KEY_COMPARE(compare_i32_asc_at, int32_t, layout.key_offset, 1)
+DEFINE_KEY_COMPARE(compare_i32_desc_at, int32_t, layout.key_offset, -1)
+DEFINE_KEY_COMPARE(compare_u32_asc_at, uint32_t, layout.key_offset, 1)
+DEFINE_KEY_COMPARE(compare_u32_desc_at, uint32_t, layout.key_offset, -1)
+DEFINE_KEY_COMPARE(compare_i64_asc_at, int64_t, layout.key_offset, 1)
+DEFINE_KEY_COMPARE(compare_i64_desc_at, int64_t, layout.key_offset, -1)
+DEFINE_KEY_COMPARE(compare_u64_asc_at, uint64_t, layout.key_offset, 1)
+DEFINE_KEY_COMPARE(compare_u64_desc_at, uint64_t, layout.key_offset, -1)
+
+/* Kernels indexed by [key_type][descending], for keys at offset 0 and elsewhere. */
+static int (*const leading_key_compare[][2])(const void *, const void *) = {
+    [KEY_I32] = {compare_i32_asc, compare_i32_desc},
+    [KEY_U32] = {compare_u32_asc, compare_u32_desc},
+    [KEY_I64] = {compare_i64_asc, compare_i64_desc},
+    [KEY_U64] = {compare_u64_asc, compare_u64_desc},
+};
+static int (*const offset_key_compare[][2])(const void *, const void *) = {
+    [KEY_I32] = {compare_i32_asc_at, compare_i32_desc_at},
+    [KEY_U32] = {compare_u32_asc_at, compare_u32_desc_at},
+    [KEY_I64] = {compare_i64_asc_at, compare_i64_desc_at},
+    [KEY_U64] = {compare_u64_asc_at, compare_u64_desc_at},
+};
+
+/* Key type names accepted by -t, indexed by enum key_type, and their sizes. */
+static const char *const key_type_names[] = {"i32", "u32", "i64", "u64"};
+static const size_t key_type_sizes[] = {4, 4, 8, 8};
+
+struct rec_layout layout = {
+    sizeof(struct rec), offsetof(struct rec, freq), KEY_I32, 0, compare_i32_asc
+};
+
+/*
+ * Set key_type to the key type called name (i32, u32, i64 or u64).
+ * Return 0 on success and -1 if name is not a key type.
+ */
+int parse_key_type(const char *name, enum key_type *key_type) {
+    for (int i = 0; i < sizeof(key_type_names) / sizeof(key_type_names[0]); i++) {
+        if (strcmp(name, key_type_names[i]) == 0) {
+            *key_type = i;
+            return 0;
+        }
     }
+    return -1;
+}
 
-    return sbuf.st_size;
+/*
+ * Set the layout of the records to sort and select the comparator for it.
+ * Return 0 on success and -1 if the key does not fit inside the record.
+ */
+int init_layout(size_t rec_size, size_t key_offset, enum key_type key_type, int descending) {
+    if (rec_size == 0 || key_offset + key_type_sizes[key_type] > rec_size) {
+        return -1;
+    }
+    descending = descending ? 1 : 0;
+    layout.rec_size = rec_size;
+    layout.key_offset = key_offset;
+    layout.key_type = key_type;
+    layout.descending = descending;
+    if (key_offset == 0) {
+        layout.compare = leading_key_compare[key_type][descending];
+    } else {
+        layout.compare = offset_key_compare[key_type][descending];
+    }
+    return 0;
 }
 
-/* A comparison function to use for qsort */
-int compare_freq(const void *rec1, const void *rec2) {
+/*
+ * Sort rec_num records of the current layout in place.
+ * Records with 32-bit keys are sorted as packed (key, index) pairs by the vectorized
+ * kernels in simdsort.c and then moved into place; other keys fall back to qsort.
+ */
+void sort_records(char *recs, int rec_num) {
+    if (rec_num < 2) {
+        return;
+    }
+    if (layout.key_type != KEY_I32 && layout.key_type != KEY_U32) {
+        qsort(recs, rec_num, layout.rec_size, layout.compare);
+        return;
+    }
+    size_t cap = sort_keys_capacity(rec_num);
+    int64_t *keys = malloc(2 * cap * sizeof(int64_t));
+    char *sorted = malloc((size_t) rec_num * layout.rec_size);
+    if (keys == NULL || sorted == NULL) {
+        perror("Allocating memory for sort keys fails");
+        exit(1);
+    }
+    // Map the key to an unsigned value in the wanted order and pack it above the index, then
+    // flip the top bit so signed comparison of the packed keys matches unsigned order.
+    uint32_t flip = layout.key_type == KEY_I32 ? 0x80000000u : 0;
+    uint32_t invert = layout.descending ? 0xffffffffu : 0;
+    const char *rec = recs + layout.key_offset;
+    for (int i = 0; i < rec_num; i++, rec += layout.rec_size) {
+        uint32_t key;
+        memcpy(&key, rec, sizeof(key));
+        uint64_t packed = ((uint64_t) ((key ^ flip) ^ invert) << 32) | (uint32_t) i;
+        keys[i] = (int64_t) (packed ^ 0x8000000000000000ull);
+    }
+    sort_keys(keys, rec_num, keys + cap);
+    for (int i = 0; i < rec_num; i++) {
+        uint32_t index = (uint32_t) keys[i];
+        memcpy(sorted + (size_t) i * layout.rec_size, recs + (size_t) index * layout.rec_size,
+               layout.rec_size);
+    }
+    memcpy(recs, sorted, (size_t) rec_num * layout.rec_size);
+    free(sorted);
+    free(keys);
+}
 
-    struct rec *r1 = (struct rec *) rec1;
-    struct rec *r2 = (struct rec *) rec2;
+long get_file_size(char *filename) {
+    struct stat sbuf;
 
-    if (r1->freq == r2->freq) {
-        return 0;
-    } else if (r1->freq > r2->freq) {
-        return 1;
-    } else {
-        return -1;
+    if ((stat(filename, &sbuf)) == -1) {
+       perror("stat");
+       exit(1);
     }
+
+    return sbuf.st_size;
 }
 
 /*
- * rec2 is struct rec with augmented info, index of child process and index of the record in 2-dimension
- * array file_content.
- * A comparison function to use for qsort rec2.
+ * run_head is the next unmerged record of a run, with the index of its child process and
+ * its index in the 2-dimension array file_content.
+ * A comparison function to use for qsort run_head.
  * */
-int compare_freq_rec2(const void *rec1, const void *rec2) {
+int compare_run_head(const void *head1, const void *head2) {
 
-    struct rec2 *r1 = (struct rec2 *) rec1;
-    struct rec2 *r2 = (struct rec2 *) rec2;
+    const struct run_head *h1 = (const struct run_head *) head1;
+    const struct run_head *h2 = (const struct run_head *) head2;
 
-    if (r1->freq == r2->freq) {
-        return 0;
-    } else if (r1->freq > r2->freq) {
-        return 1;
-    } else {
-        return -1;
-    }
+    return layout.compare(h1->rec, h2->rec);
 }
 
 /*
  * In child process, read i-th chunk of input file. Sort records and write to i-th child pipe
  */
-void read_input_file(char* infile,int pipe_fd[][2], int read_offset, int i, int read_num, struct rec* read_content){
+void read_input_file(char* infile,int pipe_fd[][2], int read_offset, int i, int read_num, char* read_content){
     //open the input file and check error.
     FILE* fp = fopen(infile, "rb");
     if (fp == NULL) {
@@ -63,7 +176,7 @@ void read_input_file(char* infile,int pipe_fd[][2], int read_offset, int i, int
         exit(1);
     }
     //Set the file position and check error.
-    if(fseek(fp, read_offset * sizeof(struct rec), SEEK_SET) == -1){
+    if(fseek(fp, (long) read_offset * layout.rec_size, SEEK_SET) == -1){
         perror("fseek fail");
         exit(1);
     }
@@ -79,30 +192,20 @@ void read_input_file(char* infile,int pipe_fd[][2], int read_offset, int i, int
             exit(1);
         }
     }
-    //Declare an array of records to store data to be read. And it will be written to pipe.
-    //struct rec read_content[read_num];
-
     //Read data from input file and check error.
-    for(int rec_index =0; rec_index< read_num; rec_index++){
-        if(fread(&(read_content[rec_index]), sizeof(struct rec), 1, fp)!= 1){
-            perror("read fail");
-            exit(1);
-        }
+    if(fread(read_content, layout.rec_size, read_num, fp) != read_num){
+        perror("read fail");
+        exit(1);
     }
     // Sort records.
-    qsort(read_content, read_num, sizeof(struct rec), compare_freq);
+    sort_records(read_content, read_num);
     // Close the input file pointer and check error.
     if(fclose(fp)!=0){
         perror("closing input file");
         exit(1);
     }
     // Write records to pipes and check error.
-    for(int rec_index = 0; rec_index < read_num; rec_index++){
-        if(write(pipe_fd[i][1], &(read_content[rec_index]), sizeof(struct rec)) != sizeof(struct rec)){
-            perror("writing from child to pipe");
-            exit(1);
-        }
-    }
+    write_full(pipe_fd[i][1], read_content, (size_t) read_num * layout.rec_size, "writing from child to pipe");
 
     // Close writing end from child and check error.
     if(close(pipe_fd[i][1]) == -1){
@@ -111,26 +214,61 @@ void read_input_file(char* infile,int pipe_fd[][2], int read_offset, int i, int
     }
 }
 
+/*
+ * Read up to len bytes from fd, retrying short reads. Return the number of bytes read,
+ * which is less than len only at end of file.
+ */
+ssize_t read_full(int fd, void *buf, size_t len){
+    size_t done = 0;
+    while(done < len){
+        ssize_t n = read(fd, (char *)buf + done, len - done);
+        if(n == -1){
+            return -1;
+        }
+        if(n == 0){
+            break;
+        }
+        done += n;
+    }
+    return done;
+}
+
+/*
+ * Write all len bytes of buf to fd, retrying short writes. what names the write in the error message.
+ */
+void write_full(int fd, const void *buf, size_t len, char *what){
+    size_t done = 0;
+    while(done < len){
+        ssize_t n = write(fd, (const char *)buf + done, len - done);
+        if(n == -1){
+            perror(what);
+            exit(1);
+        }
+        done += n;
+    }
+}
+
 /*
  * In parent process, read records from pipe.
+ * run_sizes[i] is the number of records the i-th child writes to its pipe.
  */
-void reading_from_pipe(int record_num, int chunk_num, struct rec** file_content, int pipe_fd[][2]){
+void reading_from_pipe(int chunk_num, int *run_sizes, char** file_content, int pipe_fd[][2]){
     //Store sorted array of records read from each of child pipe  into 2-dimension array -- file_content
     for(int i = 0; i < chunk_num; i++){
         //find the number of records in i-th chunk of input file
-        int read_num = read_rec_num(i, chunk_num, record_num);
-        //Allocate memory for i-th sorted array read from pipe and check error
-        file_content[i] = malloc(read_num * sizeof(struct rec));
+        int read_num = run_sizes[i];
+        //Allocate memory for i-th sorted array read from pipe and check error.
+        //A streaming worker may have received no records at all.
+        file_content[i] = malloc((read_num > 0 ? read_num : 1) * layout.rec_size);
         if(file_content[i] == NULL){
             perror("Allocating the memory of file_content fails");
             exit(1);
         }
-        // Read records from pipe and check error
-        for(int j=0; j< read_num;j++){
-            if(read(pipe_fd[i][0], &(file_content[i][j]), sizeof(struct rec)) == -1){
-                perror("reading from a child process");
-                exit(1);
-            }
+        // Read the whole run from pipe and check error
+        if(read_full(pipe_fd[i][0], file_content[i], (size_t) read_num * layout.rec_size)
+           != (size_t) read_num * layout.rec_size){
+            perror("reading from a child process");
+            exit(1);
         }
         // Close i-th child pipe's reading end from parent.
         if(close(pipe_fd[i][0]) == -1){
@@ -141,25 +279,25 @@ void reading_from_pipe(int record_num, int chunk_num, struct rec** file_content,
 }
 
 /*
- * merge_array stores records in the format of rec2, the record with augmented info.
- * merge_array is the array of records with smallest frequency in the unsorted part of each array read from child pipe.
- * This function is to initialize merge_array.
+ * merge_array stores the heads of the runs, the records with augmented info.
+ * merge_array is the array of records with smallest key in the unsorted part of each array read from child pipe.
+ * This function is to initialize merge_array. Empty runs are skipped.
+ * Return the number of records placed in merge_array.
  */
-void generate_merge_array(int chunk_num, struct rec2* merge_array, struct rec** file_content){
+int generate_merge_array(int chunk_num, int *run_sizes, struct run_head* merge_array, char** file_content){
+    int merge_array_size = 0;
     //loop over index of the child process
     for(int i=0; i< chunk_num; i++){
-        /*
-         * Initialize a new rec2.
-         * Invert first record in each array from child process into a records in the format of rec2.
-         * And assign i-th index of merge_array with the new rec2
-         */
-        struct rec2 new_rec2;
-        new_rec2.freq = file_content[i][0].freq;
-        strcpy(new_rec2.word,file_content[i][0].word);
-        new_rec2.child_index = i;
-        new_rec2.rec_index = 0;
-        merge_array[i] = new_rec2;
+        if(run_sizes[i] == 0){
+            continue;
+        }
+        // The head of each run starts at its first record.
+        merge_array[merge_array_size].rec = file_content[i];
+        merge_array[merge_array_size].child_index = i;
+        merge_array[merge_array_size].rec_index = 0;
+        merge_array_size++;
     }
+    return merge_array_size;
 }
 
 /*
@@ -175,59 +313,218 @@ int read_rec_num(int child_index, int chunk_num, int record_num){
 }
 
 /*
- * Merge multiple sorted arrays of records different child processes read into one sorted array of
- * all records, sorted_file_content.
+ * Return whether run head h1 goes before run head h2 in the merge. Heads with equal keys
+ * go in run order, so the merge output does not depend on how the heap is laid out.
  */
-void merge(int record_num, int chunk_num, struct rec** file_content, struct rec* sorted_file_content){
+static int run_head_before(const struct run_head *h1, const struct run_head *h2){
+    int cmp = compare_run_head(h1, h2);
+    return cmp < 0 || (cmp == 0 && h1->child_index < h2->child_index);
+}
+
+/*
+ * Move the run head at index i of the binary min-heap heap, of heap_size heads, down
+ * until neither of its children goes before it.
+ */
+static void sift_down(struct run_head *heap, int heap_size, int i){
+    struct run_head head = heap[i];
+    while(1){
+        int child = 2 * i + 1;
+        if(child >= heap_size){
+            break;
+        }
+        if(child + 1 < heap_size && run_head_before(&heap[child + 1], &heap[child])){
+            child++;
+        }
+        if(!run_head_before(&heap[child], &head)){
+            break;
+        }
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = head;
+}
+
+/*
+ * Merge chunk_num sorted runs of records, where file_content[i] holds run_sizes[i] records,
+ * into one sorted array of all records, sorted_file_content.
+ * The run heads are kept in a binary min-heap, so each record costs O(log chunk_num)
+ * comparisons however many runs there are.
+ */
+void merge_runs(int chunk_num, int *run_sizes, char** file_content, char* sorted_file_content){
     /*
-     * merge_array stores records in the format of rec2, the record with augmented info.
-     * merge_array is the array of records with smallest frequency in the unsorted part
-     * of each array read from child pipe.
+     * merge_array stores the heads of the runs, the records with augmented info.
+     * merge_array is the array of records with smallest key in the unsorted part
+     * of each array read from child pipe, as a binary min-heap.
      * Declare mere_array. Allocate memory and check error.
      */
-    struct rec2* merge_array;
-    merge_array = malloc(chunk_num* sizeof(struct rec2));
+    struct run_head* merge_array;
+    merge_array = malloc((chunk_num > 0 ? chunk_num : 1) * sizeof(struct run_head));
     if(merge_array ==NULL){
         perror("Allocating the memory of merge_array fails");
         exit(1);
     }
-    //Initialize merge_array
-    generate_merge_array(chunk_num, merge_array, file_content);
-    //sorted_rec_number indicates the number of records that have been sorted.
-    int sorted_rec_num = 0;
-    //merge_array_size indicates the size of merge_size. It equals chunk_num at first.
-    int merge_array_size = chunk_num;
+    //Initialize merge_array.
+    //merge_array_size indicates the size of merge_size. It equals the number of non-empty runs at first.
+    int merge_array_size = generate_merge_array(chunk_num, run_sizes, merge_array, file_content);
+    for(int i = merge_array_size / 2 - 1; i >= 0; i--){
+        sift_down(merge_array, merge_array_size, i);
+    }
+    //out points to where the next sorted record goes.
+    char *out = sorted_file_content;
     //loop ends until all records of all arrays read from pipes are sorted
     while(merge_array_size>0){
-        //sort the merge_array
-        qsort(merge_array, merge_array_size, sizeof(struct rec2), compare_freq_rec2);
-        //index 0 of merge_array is the record with smallest frequency among remaining records.
-        //Find its child_process index and rec_index in file_content, that is, 2 indexes of file_content[][]
+        //index 0 of merge_array is the record with smallest key among remaining records.
         int output_child_index = merge_array[0].child_index;
-        int output_rec_index = merge_array[0].rec_index;
-        // rec_index_max is the number of records the child process read
-        int rec_index_max = read_rec_num(output_child_index, chunk_num, record_num) -1 ;
+        // rec_index_max is the index of the last record of the run
+        int rec_index_max = run_sizes[output_child_index] -1 ;
         // let the record be the next in sorted_file_content
-        sorted_file_content[sorted_rec_num] = file_content[output_child_index][output_rec_index];
+        memcpy(out, merge_array[0].rec, layout.rec_size);
+        out += layout.rec_size;
 
-        if(output_rec_index < rec_index_max){//if the record is not the last one in the array.
-            // let merge_array[0] stores the info of record in next rec_index
+        if(merge_array[0].rec_index < rec_index_max){//if the record is not the last one in the array.
+            // let merge_array[0] point to the next record of the run
             merge_array[0].rec_index += 1;
-            struct rec next_rec = file_content[output_child_index][output_rec_index + 1];
-            merge_array[0].freq = next_rec.freq;
-            strcpy(merge_array[0].word, next_rec.word);
+            merge_array[0].rec += layout.rec_size;
         }else{//if the record is the last one in the array.
             merge_array_size -= 1;
             merge_array[0] = merge_array[merge_array_size];
         }
-        sorted_rec_num += 1;
+        sift_down(merge_array, merge_array_size, 0);
     }
     //After sorting, free the memory of merge_array.
     free(merge_array);
 }
 
+/*
+ * Merge multiple sorted arrays of records different child processes read into one sorted array of
+ * all records, sorted_file_content.
+ */
+void merge(int record_num, int chunk_num, char** file_content, char* sorted_file_content){
+    int run_sizes[chunk_num];
+    for(int i = 0; i < chunk_num; i++){
+        run_sizes[i] = read_rec_num(i, chunk_num, record_num);
+    }
+    merge_runs(chunk_num, run_sizes, file_content, sorted_file_content);
+}
+
+/*
+ * In parent process, read records from stdin in runs of STREAM_RUN_RECS and hand each run to
+ * the next streaming worker through to_child, round-robin, while the workers sort earlier runs.
+ * Fill run_sizes with the number of records each worker received. Return the total number of records.
+ */
+int stream_input(int chunk_num, int to_child[][2], int *run_sizes){
+    char *buf = malloc(STREAM_RUN_RECS * layout.rec_size);
+    if(buf == NULL){
+        perror("Allocating the memory of stream buffer fails");
+        exit(1);
+    }
+    for(int i = 0; i < chunk_num; i++){
+        run_sizes[i] = 0;
+    }
+    int record_num = 0;
+    int child = 0;
+    while(1){
+        ssize_t bytes = read_full(STDIN_FILENO, buf, STREAM_RUN_RECS * layout.rec_size);
+        if(bytes == -1){
+            perror("reading from stdin");
+            exit(1);
+        }
+        if(bytes % layout.rec_size != 0){
+            fprintf(stderr, "Input is not a whole number of records\n");
+            exit(1);
+        }
+        int got = bytes / layout.rec_size;
+        if(got > 0){
+            write_full(to_child[child][1], buf, bytes, "writing from parent to worker");
+            run_sizes[child] += got;
+            record_num += got;
+            child = (child + 1) % chunk_num;
+        }
+        // A short run means stdin reached end of file.
+        if(got < STREAM_RUN_RECS){
+            break;
+        }
+    }
+    // Closing the writing ends tells every worker that its input is complete.
+    for(int i = 0; i < chunk_num; i++){
+        if(close(to_child[i][1]) == -1){
+            perror("closing writing end to worker");
+            exit(1);
+        }
+    }
+    free(buf);
+    return record_num;
+}
+
+/*
+ * In a streaming worker process, read runs of records from in_fd as the parent produces them and
+ * sort each run as soon as it is complete. At end of input, merge the runs and write them to out_fd.
+ */
+void sort_stream_worker(int in_fd, int out_fd){
+    int max_recs = STREAM_RUN_RECS;
+    int rec_num = 0;
+    char *content = malloc((size_t) max_recs * layout.rec_size);
+    if(content == NULL){
+        perror("Allocating memory fails");
+        exit(1);
+    }
+    while(1){
+        // Make room for one more full run.
+        if(rec_num + STREAM_RUN_RECS > max_recs){
+            max_recs *= 2;
+            content = realloc(content, (size_t) max_recs * layout.rec_size);
+            if(content == NULL){
+                perror("Reallocating memory fails");
+                exit(1);
+            }
+        }
+        char *run = content + (size_t) rec_num * layout.rec_size;
+        ssize_t bytes = read_full(in_fd, run, STREAM_RUN_RECS * layout.rec_size);
+        if(bytes == -1){
+            perror("reading from parent");
+            exit(1);
+        }
+        int got = bytes / layout.rec_size;
+        // Sort this run while the parent is still reading the next ones.
+        sort_records(run, got);
+        rec_num += got;
+        if(got < STREAM_RUN_RECS){
+            break;
+        }
+    }
+    if(close(in_fd) == -1){
+        perror("closing reading end from worker");
+        exit(1);
+    }
+
+    // Every run but the last holds exactly STREAM_RUN_RECS records.
+    int run_num = (rec_num + STREAM_RUN_RECS - 1) / STREAM_RUN_RECS;
+    char *sorted_content = content;
+    if(run_num > 1){
+        char *runs[run_num];
+        int run_sizes[run_num];
+        for(int i = 0; i < run_num; i++){
+            runs[i] = content + (size_t) i * STREAM_RUN_RECS * layout.rec_size;
+            run_sizes[i] = (i == run_num - 1) ? rec_num - i * STREAM_RUN_RECS : STREAM_RUN_RECS;
+        }
+        sorted_content = malloc((size_t) rec_num * layout.rec_size);
+        if(sorted_content == NULL){
+            perror("Allocating memory fails");
+            exit(1);
+        }
+        merge_runs(run_num, run_sizes, runs, sorted_content);
+        free(content);
+    }
+    write_full(out_fd, sorted_content, (size_t) rec_num * layout.rec_size, "writing from worker to pipe");
+    if(close(out_fd) == -1){
+        perror("closing writing end from worker");
+        exit(1);
+    }
+    free(sorted_content);
+}
+
 /* free the memory of file_content and sorted_file_content*/
-void deallocate(int chunk_num, struct rec** file_content, struct rec* sorted_file_content){
+void deallocate(int chunk_num, char** file_content, char* sorted_file_content){
     for(int i = 0; i < chunk_num; i++){
         free(file_content[i]);
     }
@@ -236,7 +533,7 @@ void deallocate(int chunk_num, struct rec** file_content, struct rec* sorted_fil
 }
 
 /* Write sorted records to output file*/
-void writing(char* outfile, struct rec* sorted_file_content, int record_num){
+void writing(char* outfile, char* sorted_file_content, int record_num){
     // open output file and check error.
     FILE* fp = fopen(outfile, "wb");
     if(fp ==NULL){
@@ -244,7 +541,7 @@ void writing(char* outfile, struct rec* sorted_file_content, int record_num){
         exit(1);
     }
     // write data to output file.
-    if (fwrite(sorted_file_content, sizeof(struct rec), record_num , fp) != record_num ) {
+    if (fwrite(sorted_file_content, layout.rec_size, record_num , fp) != record_num ) {
         perror("Writing to output file");
         exit(1);
     }
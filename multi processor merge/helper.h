@@ -1,28 +1,68 @@
 #ifndef _HELPER_H
 #define _HELPER_H
 
+#include <stddef.h>
+#include <sys/types.h>
+
 #define SIZE 44
 
+/* Number of records a streaming worker sorts into one run (-f -). */
+#define STREAM_RUN_RECS 4096
+
+/* The default record layout, as written by mkwords. */
 struct rec {
     int freq;
     char word[SIZE];
 };
 
-struct rec2{
-    int freq;
-    char word[SIZE];
+/* Types of the key records are sorted by. */
+enum key_type {
+    KEY_I32,
+    KEY_U32,
+    KEY_I64,
+    KEY_U64
+};
+
+/*
+ * Layout of the fixed-size records being sorted: every record is rec_size bytes and
+ * holds a key of key_type at key_offset. compare is the comparator init_layout selected.
+ */
+struct rec_layout {
+    size_t rec_size;
+    size_t key_offset;
+    enum key_type key_type;
+    int descending;
+    int (*compare)(const void *rec1, const void *rec2);
+};
+
+/*
+ * The head of a sorted run during a merge: the next unmerged record of run child_index,
+ * which is at rec_index in that run.
+ */
+struct run_head {
+    const char *rec;
     int child_index;
     int rec_index;
 };
 
-int get_file_size(char *filename);
-int compare_freq(const void *rec1, const void *rec2);
-int compare_freq_rec2(const void *rec1, const void *rec2);
-void read_input_file(char* infile,int pipe_fd[][2], int read_offset, int i, int read_num, struct rec* read_content);
-void reading_from_pipe(int record_num, int chunk_num, struct rec** file_content, int pipe_fd[][2]);
-void generate_merge_array(int chunk_num, struct rec2* merge_array, struct rec** file_content);
+/* The layout of the records of this run of psort; struct rec unless init_layout changed it. */
+extern struct rec_layout layout;
+
+int parse_key_type(const char *name, enum key_type *key_type);
+int init_layout(size_t rec_size, size_t key_offset, enum key_type key_type, int descending);
+void sort_records(char *recs, int rec_num);
+long get_file_size(char *filename);
+int compare_run_head(const void *head1, const void *head2);
+void read_input_file(char* infile,int pipe_fd[][2], int read_offset, int i, int read_num, char* read_content);
+void reading_from_pipe(int chunk_num, int *run_sizes, char** file_content, int pipe_fd[][2]);
+int generate_merge_array(int chunk_num, int *run_sizes, struct run_head* merge_array, char** file_content);
 int read_rec_num(int child_index, int chunk_num, int record_num);
-void merge(int record_num, int chunk_num, struct rec** file_content, struct rec* sorted_file_content);
-void deallocate(int chunk_num, struct rec** file_content, struct rec* sorted_file_content);
-void writing(char* outfile, struct rec* sorted_file_content, int record_num);
+void merge_runs(int chunk_num, int *run_sizes, char** file_content, char* sorted_file_content);
+void merge(int record_num, int chunk_num, char** file_content, char* sorted_file_content);
+void deallocate(int chunk_num, char** file_content, char* sorted_file_content);
+void writing(char* outfile, char* sorted_file_content, int record_num);
+ssize_t read_full(int fd, void *buf, size_t len);
+void write_full(int fd, const void *buf, size_t len, char *what);
+int stream_input(int chunk_num, int to_child[][2], int *run_sizes);
+void sort_stream_worker(int in_fd, int out_fd);
 #endif /* _HELPER_H */
@@ -17,11 +17,19 @@ int uniform(int lower,int upper) {
     return (int) (floor ( drand48() * (upper - lower + 1) ) + lower);
 }
 
+/*
+ * Return a random number between lower and upper with a skewed, power-law-like
+ * distribution: small values are common and large ones rare, as with word frequencies.
+ */
+int skewed(int lower, int upper) {
+    return (int) (floor ( pow(drand48(), 4) * (upper - lower + 1) ) + lower);
+}
+
 /* This program takes as input a file containing one word per line.  
  * It uses the each word together with a randomly generated frequency count 
  * to create a struct that is written to the output file.
  * The result is a binary file in the correct format to use as input to
- * psort.
+ * psort. With -s the frequencies are skewed instead of uniformly distributed.
  * 
  * To compile the program the math library must be linked:
  *          gcc -Wall -g -std=gnu99 -o mkwords mkwords.c -lm
@@ -33,14 +41,15 @@ int main(int argc, char *argv[]) {
     FILE *infp, *outfp;
     struct rec record;
     char *infile = NULL, *outfile = NULL;
+    int (*distribution)(int, int) = uniform;
 
-    if (argc != 5) {
-        fprintf(stderr, "Usage: mkwords -f <input file name> -o <output file name>\n");
+    if (argc != 5 && argc != 6) {
+        fprintf(stderr, "Usage: mkwords [-s] -f <input file name> -o <output file name>\n");
         exit(1);
     }
 
     /* read in arguments */
-    while ((ch = getopt(argc, argv, "f:o:")) != -1) {
+    while ((ch = getopt(argc, argv, "sf:o:")) != -1) {
         switch(ch) {
         case 'f':
             infile = optarg;
@@ -48,8 +57,11 @@ int main(int argc, char *argv[]) {
         case 'o':
             outfile = optarg;
             break;
+        case 's':
+            distribution = skewed;
+            break;
         default:
-            fprintf(stderr, "Usage: mkwords -f <input file name> -o <output file name>\n");
+            fprintf(stderr, "Usage: mkwords [-s] -f <input file name> -o <output file name>\n");
             exit(1);
         }
     }
@@ -72,7 +84,7 @@ int main(int argc, char *argv[]) {
     while ((fgets(record.word, sizeof(record.word), infp)) != NULL) {
 		// remove the newline character
         record.word[strlen(record.word) - 1] = '\0';
-        record.freq = uniform(0, UPPER);
+        record.freq = distribution(0, UPPER);
 
         if ((fwrite(&record, sizeof(record), 1, outfp)) != 1) {
             fprintf(stderr, "Could not write to %s\n", outfile);
@@ -7,6 +7,85 @@
 #include <getopt.h>
 #include <sys/wait.h>
 #include "helper.h"
+#include "verify.h"
+
+#define USAGE "Usage: psort [--verify] -n <number of processes> -f <inputfile | -> -o <outputfile>\n" \
+              "             [-s <record size> -k <key offset> -t <i32|u32|i64|u64> -r]\n"
+
+
+/*
+ * Sort records streamed on stdin with chunk_num worker processes and write them to outfile.
+ * The parent hands fixed-size runs to the workers as stdin produces them, so runs are sorted
+ * while input is still arriving; the workers' results are merged at end of input.
+ */
+void stream_sort(int chunk_num, char *outfile){
+    // status is the status of a process
+    int status;
+    // to_child[i] carries runs from the parent to worker i, pipe_fd[i] carries its sorted records back.
+    int to_child[chunk_num][2];
+    int pipe_fd[chunk_num][2];
+    // run_sizes[i] is the number of records worker i receives.
+    int run_sizes[chunk_num];
+
+    for(int i = 0; i < chunk_num; i++){
+        if(pipe(to_child[i]) == -1 || pipe(pipe_fd[i]) == -1){
+            perror("pipe");
+            exit(1);
+        }
+        int result = fork();
+        if(result < 0){
+            perror("fork");
+            exit(1);
+        }else if(result == 0){
+            // Close the ends that belong to the parent, including those of previous workers,
+            // so every worker sees end of file once the parent closes its writing end.
+            for(int child_no = 0; child_no < i; child_no++){
+                if(close(to_child[child_no][1]) == -1 || close(pipe_fd[child_no][0]) == -1){
+                    perror("closing pipes of previous workers");
+                    exit(1);
+                }
+            }
+            if(close(to_child[i][1]) == -1 || close(pipe_fd[i][0]) == -1){
+                perror("closing parent ends from inside worker");
+                exit(1);
+            }
+            sort_stream_worker(to_child[i][0], pipe_fd[i][1]);
+            exit(0);
+        }else{
+            if(close(to_child[i][0]) == -1 || close(pipe_fd[i][1]) == -1){
+                perror("closing worker ends from parent");
+                exit(1);
+            }
+        }
+    }
+    // Distribute stdin to the workers until end of file.
+    int record_num = stream_input(chunk_num, to_child, run_sizes);
+
+    char** file_content = malloc(chunk_num * sizeof(char*));
+    if(file_content == NULL){
+        perror("file_content memory allocating fail");
+        exit(1);
+    }
+    reading_from_pipe(chunk_num, run_sizes, file_content, pipe_fd);
+
+    for(int i =0;i < chunk_num; i++) {
+        if (wait(&status) == -1) {
+            fprintf(stderr, "Child terminated abnormally\n");
+            exit(1);
+        } else if (WEXITSTATUS(status)) {
+            fprintf(stderr, "Child terminated abnormally\n");
+            exit(1);
+        }
+    }
+    char* sorted_file_content = malloc((record_num > 0 ? record_num : 1) * layout.rec_size);
+    if(sorted_file_content == NULL){
+        perror("Allocating the memory of sorted_file_content fails");
+        exit(1);
+    }
+    merge_runs(chunk_num, run_sizes, file_content, sorted_file_content);
+    writing(outfile, sorted_file_content, record_num);
+    deallocate(chunk_num, file_content, sorted_file_content);
+}
 
 
 int main(int argc, char *argv[]) {
@@ -16,38 +95,92 @@ int main(int argc, char *argv[]) {
     // the name of input and output file
     char *infile = NULL, *outfile = NULL;
     // chunk_num indicates how many chunks the input file are divided into
-    int chunk_num;
+    int chunk_num = 0;
     //option indicates the option name in the command line
     int option;
+    // verify is set by --verify: check outfile against infile instead of sorting.
+    int verify = 0;
+    // The record layout; by default that of struct rec, sorted by ascending freq.
+    long rec_size = layout.rec_size, key_offset = layout.key_offset;
+    enum key_type key_type = layout.key_type;
+    int descending = 0;
+    struct option long_options[] = {
+        {"verify", no_argument, &verify, 1},
+        {0, 0, 0, 0}
+    };
 
-    // check the number of command-line arguments
-    if (argc != 7) {
-        fprintf(stderr, "Usage: psort -n <number of processes> -f <inputfile> -o <outputfile>\n");
-        exit(1);
-    }
     // check whether options -n , -f , -o are provided in the command-line argument.
-    while ((option = getopt(argc, argv, "n:f:o:")) != -1) {
+    while ((option = getopt_long(argc, argv, "n:f:o:s:k:t:r", long_options, NULL)) != -1) {
         switch(option) {
+            case 0:
+                break;
             case 'n':
                 chunk_num = strtol(optarg, NULL, 10);
+                break;
             case 'f':
                 infile = optarg;
                 break;
             case 'o':
                 outfile = optarg;
                 break;
+            case 's':
+                rec_size = strtol(optarg, NULL, 10);
+                break;
+            case 'k':
+                key_offset = strtol(optarg, NULL, 10);
+                break;
+            case 't':
+                if(parse_key_type(optarg, &key_type) == -1){
+                    fprintf(stderr, "Unknown key type %s\n", optarg);
+                    exit(1);
+                }
+                break;
+            case 'r':
+                descending = 1;
+                break;
             default:
-                fprintf(stderr, "Usage: mkwords -f <input file name> -o <output file name>\n");
+                fprintf(stderr, USAGE);
                 exit(1);
         }
     }
+    // check that every option was given exactly as expected.
+    if (optind != argc || infile == NULL || outfile == NULL) {
+        fprintf(stderr, USAGE);
+        exit(1);
+    }
+    if(chunk_num < 1){
+        fprintf(stderr, "The number of processes must be positive\n");
+        exit(1);
+    }
+    if(rec_size < 1 || key_offset < 0 || init_layout(rec_size, key_offset, key_type, descending) == -1){
+        fprintf(stderr, "The key must lie inside the record\n");
+        exit(1);
+    }
+    // --verify checks outfile with chunk_num threads and exits with the result.
+    if(verify){
+        if(strcmp(infile, "-") == 0){
+            fprintf(stderr, "--verify needs a named input file\n");
+            exit(1);
+        }
+        return verify_output(infile, outfile, chunk_num);
+    }
+    // "-f -" sorts an unbounded stream of records read from stdin.
+    if(strcmp(infile, "-") == 0){
+        stream_sort(chunk_num, outfile);
+        return 0;
+    }
     // Declare and initialize variables.
     // Declare pipe_fd for parent process and its child processes.
     int pipe_fd[chunk_num][2];
     // read_num is the number of records that the child process in current iteration will read.
     int read_num;
     // record_num is the total number of records in the input file.
-    int record_num = get_file_size(infile)/ sizeof(struct rec);
+    long file_size = get_file_size(infile);
+    if(file_size % layout.rec_size != 0){
+        fprintf(stderr, "%s is not a whole number of records\n", infile);
+        exit(1);
+    }
+    int record_num = file_size / layout.rec_size;
     //read_offset is the distance between SEEK_SET and the location where to begin to read in current iteration.
     int read_offset = 0;
     // the maximum of chunk_num is record_num. It is unnecessary to create more than record_num child processes.
@@ -72,8 +205,8 @@ int main(int argc, char *argv[]) {
             exit(1);
         }else if(result ==0){// the case where it is in a child process.
             //Read i-th chunk of input file. Sort them and write to current child pipe.
-            struct rec* read_content;
-            read_content = malloc(read_num *sizeof(struct rec)); 
+            char* read_content;
+            read_content = malloc((size_t) read_num * layout.rec_size);
             if(read_content ==NULL){
                perror("Allocating memory fails");
                exit(1);
@@ -96,13 +229,18 @@ int main(int argc, char *argv[]) {
      * is a 2-dimension array storing records.
      * Allocate the memory for file_content and check error.
      */
-    struct rec** file_content = malloc(chunk_num * sizeof(struct rec*));
+    char** file_content = malloc(chunk_num * sizeof(char*));
     if(file_content == NULL){
         perror("file_content memory allocating fail");
         exit(1);
     }
+    // run_sizes[i] is the number of records the i-th child sends back.
+    int run_sizes[chunk_num];
+    for(int i = 0; i < chunk_num; i++){
+        run_sizes[i] = read_rec_num(i, chunk_num, record_num);
+    }
     // read the input file content from pipe and store it in file_content
-    reading_from_pipe(record_num,  chunk_num, file_content, pipe_fd);
+    reading_from_pipe(chunk_num, run_sizes, file_content, pipe_fd);
 
     //Parent waits for child processes. And check the error of child's abnormal terminating.
     for(int i =0;i < chunk_num; i++) {
@@ -118,7 +256,7 @@ int main(int argc, char *argv[]) {
      * sorted_file_content is a 1-dimension array to store sorted records.
      * Allocate the memory for sorted_file_content and check error.
      */
-    struct rec* sorted_file_content = malloc(record_num * sizeof(struct rec));
+    char* sorted_file_content = malloc((record_num > 0 ? record_num : 1) * layout.rec_size);
     if(sorted_file_content == NULL){
         perror("Allocating the memory of sorted_file_content fails");
         exit(1);
@@ -127,7 +265,7 @@ int main(int argc, char *argv[]) {
      * merge multiple sorted arrays of records different child processes read into one sorted array of
      * all records, sorted_file_content.
      */
-    merge(record_num, chunk_num, file_content, sorted_file_content);
+    merge_runs(chunk_num, run_sizes, file_content, sorted_file_content);
     //write sorted records to output file
     writing(outfile, sorted_file_content, record_num);
 
@@ -0,0 +1,295 @@
+/*
+ * Sorting of 64-bit signed keys with in-register sorting networks and bitonic merge
+ * kernels. psort packs each record's 32-bit key and its index into one such key.
+ *
+ * Every implementation works the same way: sort fixed blocks of SORT_BLOCK keys into
+ * short runs with a sorting network, then merge runs bottom-up, merging a few keys per
+ * step with a bitonic merge network. The AVX2 kernel keeps 4 keys per register, the
+ * SSE kernel 2 and the scalar kernel 1, using branch-free min/max throughout.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <immintrin.h>
+#include "simdsort.h"
+
+#define AVX2 __attribute__((target("avx2")))
+#define SSE42 __attribute__((target("sse4.2")))
+
+/* The kernel sort_keys uses; -1 until it is first needed. */
+static int current_kernel = -1;
+
+static const char *const kernel_names[] = {"scalar", "sse4.2", "avx2"};
+
+/* Return the fastest kernel this CPU supports. */
+enum sort_kernel best_sort_kernel(void) {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return KERNEL_AVX2;
+    }
+    if (__builtin_cpu_supports("sse4.2")) {
+        return KERNEL_SSE;
+    }
+    return KERNEL_SCALAR;
+}
+
+/* Use kernel for later calls to sort_keys; it must be supported by the CPU. */
+void set_sort_kernel(enum sort_kernel kernel) {
+    current_kernel = kernel;
+}
+
+enum sort_kernel get_sort_kernel(void) {
+    if (current_kernel == -1) {
+        current_kernel = best_sort_kernel();
+    }
+    return current_kernel;
+}
+
+const char *sort_kernel_name(enum sort_kernel kernel) {
+    return kernel_names[kernel];
+}
+
+/* Return the number of keys sort_keys needs room for when sorting n keys. */
+size_t sort_keys_capacity(size_t n) {
+    return (n + SORT_BLOCK - 1) / SORT_BLOCK * SORT_BLOCK;
+}
+
+/* ---------------------------------------------------------------- scalar kernel */
+
+#define MIN64(a, b) ((a) < (b) ? (a) : (b))
+#define MAX64(a, b) ((a) < (b) ? (b) : (a))
+#define SWAP_IF_GREATER(a, b) do { int64_t lo_ = MIN64(a, b); b = MAX64(a, b); a = lo_; } while (0)
+
+/* Sort each group of 4 keys of one block with a 5-comparator network. */
+static void block_sort_scalar(int64_t *p) {
+    for (int i = 0; i < SORT_BLOCK; i += 4) {
+        int64_t a = p[i], b = p[i + 1], c = p[i + 2], d = p[i + 3];
+        SWAP_IF_GREATER(a, b);
+        SWAP_IF_GREATER(c, d);
+        SWAP_IF_GREATER(a, c);
+        SWAP_IF_GREATER(b, d);
+        SWAP_IF_GREATER(b, c);
+        p[i] = a;
+        p[i + 1] = b;
+        p[i + 2] = c;
+        p[i + 3] = d;
+    }
+}
+
+/* Merge sorted runs a and b into out without data-dependent branches. */
+static void merge_scalar(const int64_t *a, size_t na, const int64_t *b, size_t nb, int64_t *out) {
+    size_t i = 0, j = 0;
+    while (i < na && j < nb) {
+        int64_t x = a[i], y = b[j];
+        int take_b = y < x;
+        *out++ = take_b ? y : x;
+        j += take_b;
+        i += !take_b;
+    }
+    memcpy(out, a + i, (na - i) * sizeof(int64_t));
+    memcpy(out + (na - i), b + j, (nb - j) * sizeof(int64_t));
+}
+
+/* ---------------------------------------------------------------- SSE kernel */
+
+SSE42 static inline __m128i min_sse(__m128i a, __m128i b) {
+    return _mm_blendv_epi8(a, b, _mm_cmpgt_epi64(a, b));
+}
+
+SSE42 static inline __m128i max_sse(__m128i a, __m128i b) {
+    return _mm_blendv_epi8(b, a, _mm_cmpgt_epi64(a, b));
+}
+
+/* Sort a bitonic pair of keys. */
+SSE42 static inline __m128i bitonic2_sse(__m128i v) {
+    __m128i s = _mm_shuffle_epi32(v, 0x4E);
+    return _mm_unpacklo_epi64(min_sse(v, s), max_sse(v, s));
+}
+
+/* Merge sorted pairs *a and *b; *a gets the 2 smallest keys, *b the 2 largest. */
+SSE42 static inline void bitonic_merge_sse(__m128i *a, __m128i *b) {
+    __m128i r = _mm_shuffle_epi32(*b, 0x4E);
+    __m128i lo = min_sse(*a, r), hi = max_sse(*a, r);
+    *a = bitonic2_sse(lo);
+    *b = bitonic2_sse(hi);
+}
+
+/* Sort one block into runs of 4 keys: a network across 2 registers, a transpose, a merge. */
+SSE42 static void block_sort_sse(int64_t *p) {
+    for (int i = 0; i < SORT_BLOCK; i += 4) {
+        __m128i r0 = _mm_loadu_si128((__m128i *) (p + i));
+        __m128i r1 = _mm_loadu_si128((__m128i *) (p + i + 2));
+        __m128i lo = min_sse(r0, r1), hi = max_sse(r0, r1);
+        r0 = _mm_unpacklo_epi64(lo, hi);
+        r1 = _mm_unpackhi_epi64(lo, hi);
+        bitonic_merge_sse(&r0, &r1);
+        _mm_storeu_si128((__m128i *) (p + i), r0);
+        _mm_storeu_si128((__m128i *) (p + i + 2), r1);
+    }
+}
+
+/* Merge sorted runs whose lengths are multiples of 2, 2 keys per step. */
+SSE42 static void merge_sse(const int64_t *a, size_t na, const int64_t *b, size_t nb, int64_t *out) {
+    __m128i va = _mm_loadu_si128((__m128i *) a);
+    __m128i vb = _mm_loadu_si128((__m128i *) b);
+    size_t i = 2, j = 2;
+    while (1) {
+        bitonic_merge_sse(&va, &vb);
+        _mm_storeu_si128((__m128i *) out, va);
+        out += 2;
+        // The next 2 keys out are among vb and the next pair of the run with the smaller head.
+        if (i < na && (j >= nb || a[i] < b[j])) {
+            va = _mm_loadu_si128((__m128i *) (a + i));
+            i += 2;
+        } else if (j < nb) {
+            va = _mm_loadu_si128((__m128i *) (b + j));
+            j += 2;
+        } else {
+            break;
+        }
+    }
+    _mm_storeu_si128((__m128i *) out, vb);
+}
+
+/* ---------------------------------------------------------------- AVX2 kernel */
+
+AVX2 static inline __m256i min_avx2(__m256i a, __m256i b) {
+    return _mm256_blendv_epi8(a, b, _mm256_cmpgt_epi64(a, b));
+}
+
+AVX2 static inline __m256i max_avx2(__m256i a, __m256i b) {
+    return _mm256_blendv_epi8(b, a, _mm256_cmpgt_epi64(a, b));
+}
+
+/* Sort a bitonic sequence of 4 keys: compare at distance 2, then at distance 1. */
+AVX2 static inline __m256i bitonic4_avx2(__m256i v) {
+    __m256i s = _mm256_permute4x64_epi64(v, 0x4E);
+    v = _mm256_blend_epi32(min_avx2(v, s), max_avx2(v, s), 0xF0);
+    s = _mm256_permute4x64_epi64(v, 0xB1);
+    return _mm256_blend_epi32(min_avx2(v, s), max_avx2(v, s), 0xCC);
+}
+
+/* Merge sorted quads *a and *b; *a gets the 4 smallest keys, *b the 4 largest. */
+AVX2 static inline void bitonic_merge_avx2(__m256i *a, __m256i *b) {
+    __m256i r = _mm256_permute4x64_epi64(*b, 0x1B);
+    __m256i lo = min_avx2(*a, r), hi = max_avx2(*a, r);
+    *a = bitonic4_avx2(lo);
+    *b = bitonic4_avx2(hi);
+}
+
+/*
+ * Sort one block into 2 runs of 8 keys. A 5-comparator network across 4 registers sorts
+ * the columns, a 4x4 transpose turns columns into sorted quads, and two bitonic merges
+ * join the quads pairwise.
+ */
+AVX2 static void block_sort_avx2(int64_t *p) {
+    __m256i r0 = _mm256_loadu_si256((__m256i *) p);
+    __m256i r1 = _mm256_loadu_si256((__m256i *) (p + 4));
+    __m256i r2 = _mm256_loadu_si256((__m256i *) (p + 8));
+    __m256i r3 = _mm256_loadu_si256((__m256i *) (p + 12));
+    __m256i t;
+
+#define CMP_SWAP_AVX2(x, y) (t = min_avx2(x, y), y = max_avx2(x, y), x = t)
+    CMP_SWAP_AVX2(r0, r1);
+    CMP_SWAP_AVX2(r2, r3);
+    CMP_SWAP_AVX2(r0, r2);
+    CMP_SWAP_AVX2(r1, r3);
+    CMP_SWAP_AVX2(r1, r2);
+#undef CMP_SWAP_AVX2
+
+    __m256i t0 = _mm256_unpacklo_epi64(r0, r1);
+    __m256i t1 = _mm256_unpackhi_epi64(r0, r1);
+    __m256i t2 = _mm256_unpacklo_epi64(r2, r3);
+    __m256i t3 = _mm256_unpackhi_epi64(r2, r3);
+    r0 = _mm256_permute2x128_si256(t0, t2, 0x20);
+    r1 = _mm256_permute2x128_si256(t1, t3, 0x20);
+    r2 = _mm256_permute2x128_si256(t0, t2, 0x31);
+    r3 = _mm256_permute2x128_si256(t1, t3, 0x31);
+
+    bitonic_merge_avx2(&r0, &r1);
+    bitonic_merge_avx2(&r2, &r3);
+    _mm256_storeu_si256((__m256i *) p, r0);
+    _mm256_storeu_si256((__m256i *) (p + 4), r1);
+    _mm256_storeu_si256((__m256i *) (p + 8), r2);
+    _mm256_storeu_si256((__m256i *) (p + 12), r3);
+}
+
+/* Merge sorted runs whose lengths are multiples of 4, 4 keys per step. */
+AVX2 static void merge_avx2(const int64_t *a, size_t na, const int64_t *b, size_t nb, int64_t *out) {
+    __m256i va = _mm256_loadu_si256((__m256i *) a);
+    __m256i vb = _mm256_loadu_si256((__m256i *) b);
+    size_t i = 4, j = 4;
+    while (1) {
+        bitonic_merge_avx2(&va, &vb);
+        _mm256_storeu_si256((__m256i *) out, va);
+        out += 4;
+        // The next 4 keys out are among vb and the next quad of the run with the smaller head.
+        if (i < na && (j >= nb || a[i] < b[j])) {
+            va = _mm256_loadu_si256((__m256i *) (a + i));
+            i += 4;
+        } else if (j < nb) {
+            va = _mm256_loadu_si256((__m256i *) (b + j));
+            j += 4;
+        } else {
+            break;
+        }
+    }
+    _mm256_storeu_si256((__m256i *) out, vb);
+}
+
+/* ---------------------------------------------------------------- driver */
+
+/*
+ * Sort keys[0..n) in ascending order. keys and tmp must both have room for
+ * sort_keys_capacity(n) keys; the padding is overwritten.
+ */
+void sort_keys(int64_t *keys, size_t n, int64_t *tmp) {
+    size_t cap = sort_keys_capacity(n);
+    void (*block_sort)(int64_t *);
+    void (*merge)(const int64_t *, size_t, const int64_t *, size_t, int64_t *);
+    size_t width;
+
+    switch (get_sort_kernel()) {
+    case KERNEL_AVX2:
+        block_sort = block_sort_avx2;
+        merge = merge_avx2;
+        width = 8;
+        break;
+    case KERNEL_SSE:
+        block_sort = block_sort_sse;
+        merge = merge_sse;
+        width = 4;
+        break;
+    default:
+        block_sort = block_sort_scalar;
+        merge = merge_scalar;
+        width = 4;
+        break;
+    }
+
+    // Pad with the largest key so every run is a whole number of vectors; pads sort last.
+    for (size_t i = n; i < cap; i++) {
+        keys[i] = INT64_MAX;
+    }
+    for (size_t i = 0; i < cap; i += SORT_BLOCK) {
+        block_sort(keys + i);
+    }
+
+    int64_t *src = keys, *dst = tmp;
+    for (; width < cap; width *= 2) {
+        for (size_t lo = 0; lo < cap; lo += 2 * width) {
+            size_t mid = lo + width < cap ? lo + width : cap;
+            size_t hi = lo + 2 * width < cap ? lo + 2 * width : cap;
+            if (mid == hi) {
+                memcpy(dst + lo, src + lo, (hi - lo) * sizeof(int64_t));
+            } else {
+                merge(src + lo, mid - lo, src + mid, hi - mid, dst + lo);
+            }
+        }
+        int64_t *t = src;
+        src = dst;
+        dst = t;
+    }
+    if (src != keys) {
+        memcpy(keys, src, n * sizeof(int64_t));
+    }
+}
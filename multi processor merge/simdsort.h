@@ -0,0 +1,24 @@
+#ifndef _SIMDSORT_H
+#define _SIMDSORT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Keys are padded up to a multiple of this many elements before sorting. */
+#define SORT_BLOCK 16
+
+/* Implementations of sort_keys, from slowest to fastest. */
+enum sort_kernel {
+    KERNEL_SCALAR,
+    KERNEL_SSE,
+    KERNEL_AVX2
+};
+
+enum sort_kernel best_sort_kernel(void);
+void set_sort_kernel(enum sort_kernel kernel);
+enum sort_kernel get_sort_kernel(void);
+const char *sort_kernel_name(enum sort_kernel kernel);
+size_t sort_keys_capacity(size_t n);
+void sort_keys(int64_t *keys, size_t n, int64_t *tmp);
+
+#endif /* _SIMDSORT_H */
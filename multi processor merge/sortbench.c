@@ -0,0 +1,107 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+#include "helper.h"
+#include "simdsort.h"
+
+/* Benchmark the chunk sort of psort: qsort against each sort kernel the CPU supports,
+ * on the records of a file made by mkwords (uniform, or skewed with mkwords -s).
+ *
+ * To compile the program:
+ *          make sortbench
+ */
+
+/* Return the current monotonic time in seconds. */
+double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Return 1 if the rec_num records in recs are ordered by the layout's key. */
+int is_sorted(char *recs, int rec_num) {
+    for (int i = 1; i < rec_num; i++) {
+        if (layout.compare(recs + (size_t) (i - 1) * layout.rec_size, recs + (size_t) i * layout.rec_size) > 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int main(int argc, char *argv[]) {
+    char *infile = NULL;
+    int repeats = 5;
+    int ch;
+
+    while ((ch = getopt(argc, argv, "f:r:")) != -1) {
+        switch(ch) {
+        case 'f':
+            infile = optarg;
+            break;
+        case 'r':
+            repeats = strtol(optarg, NULL, 10);
+            break;
+        default:
+            fprintf(stderr, "Usage: sortbench -f <input file name> [-r <repeats>]\n");
+            exit(1);
+        }
+    }
+    if (infile == NULL || repeats < 1) {
+        fprintf(stderr, "Usage: sortbench -f <input file name> [-r <repeats>]\n");
+        exit(1);
+    }
+
+    int rec_num = get_file_size(infile) / layout.rec_size;
+    size_t bytes = (size_t) rec_num * layout.rec_size;
+    char *input = malloc(bytes);
+    char *work = malloc(bytes);
+    if (input == NULL || work == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+    FILE *fp = fopen(infile, "rb");
+    if (fp == NULL || fread(input, layout.rec_size, rec_num, fp) != rec_num) {
+        fprintf(stderr, "Cannot read %s\n", infile);
+        exit(1);
+    }
+    fclose(fp);
+
+    // Time qsort first; it is the baseline for every kernel.
+    double best = 0;
+    for (int r = 0; r < repeats; r++) {
+        memcpy(work, input, bytes);
+        double start = now();
+        qsort(work, rec_num, layout.rec_size, layout.compare);
+        double t = now() - start;
+        if (r == 0 || t < best) {
+            best = t;
+        }
+    }
+    double qsort_time = best;
+    printf("%d records\n", rec_num);
+    printf("%-8s %10.3f ms\n", "qsort", qsort_time * 1000);
+
+    for (enum sort_kernel k = KERNEL_SCALAR; k <= best_sort_kernel(); k++) {
+        set_sort_kernel(k);
+        for (int r = 0; r < repeats; r++) {
+            memcpy(work, input, bytes);
+            double start = now();
+            sort_records(work, rec_num);
+            double t = now() - start;
+            if (r == 0 || t < best) {
+                best = t;
+            }
+        }
+        if (!is_sorted(work, rec_num)) {
+            fprintf(stderr, "%s kernel produced unsorted output\n", sort_kernel_name(k));
+            exit(1);
+        }
+        printf("%-8s %10.3f ms  %5.2fx\n", sort_kernel_name(k), best * 1000, qsort_time / best);
+    }
+
+    free(input);
+    free(work);
+    return 0;
+}
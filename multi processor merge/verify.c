@@ -0,0 +1,185 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "helper.h"
+#include "verify.h"
+
+/* Seeds of the two per-record hashes making up a checksum. */
+#define HASH_SEED1 0x9e3779b97f4a7c15ULL
+#define HASH_SEED2 0xc2b2ae3d27d4eb4fULL
+
+/* The part of the file one thread scans: records [begin, end). */
+struct scan_job {
+    const char *recs;
+    size_t begin;
+    size_t end;
+    int check_order;
+    struct scan_result result;
+};
+
+/* Finalizer of splitmix64, used to mix one 8-byte word into the hash. */
+static uint64_t mix64(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+/* Hash every byte of one record, so identical records always hash alike. */
+static uint64_t hash_rec(const char *r, uint64_t seed) {
+    const unsigned char *bytes = (const unsigned char *) r;
+    uint64_t h = seed;
+    size_t i;
+    for (i = 0; i + sizeof(uint64_t) <= layout.rec_size; i += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, bytes + i, sizeof(word));
+        h = mix64(h ^ word);
+    }
+    for (; i < layout.rec_size; i++) {
+        h = mix64(h ^ bytes[i]);
+    }
+    return h;
+}
+
+/*
+ * Thread body: hash records [begin, end) and, if asked, check each of them against its
+ * predecessor with the layout's comparator. The predecessor of begin belongs to the previous job, so seams between
+ * jobs are checked too.
+ */
+static void *scan_range(void *arg) {
+    struct scan_job *job = arg;
+    struct scan_result *res = &job->result;
+    res->check.sum = 0;
+    res->check.sum2 = 0;
+    res->check.rec_num = job->end - job->begin;
+    res->sorted = 1;
+    res->first_bad = 0;
+
+    const char *rec = job->recs + job->begin * layout.rec_size;
+    for (size_t i = job->begin; i < job->end; i++, rec += layout.rec_size) {
+        res->check.sum += hash_rec(rec, HASH_SEED1);
+        res->check.sum2 += hash_rec(rec, HASH_SEED2);
+        if (job->check_order && res->sorted && i > 0
+            && layout.compare(rec - layout.rec_size, rec) > 0) {
+            res->sorted = 0;
+            res->first_bad = i;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * mmap filename and scan it with thread_num threads, filling result with the checksum of its
+ * records and, if check_order is set, whether the records are sorted by key.
+ */
+void scan_file(char *filename, int thread_num, int check_order, struct scan_result *result) {
+    int fd = open(filename, O_RDONLY);
+    if (fd == -1) {
+        perror(filename);
+        exit(1);
+    }
+    struct stat sbuf;
+    if (fstat(fd, &sbuf) == -1) {
+        perror("fstat");
+        exit(1);
+    }
+    if (sbuf.st_size % layout.rec_size != 0) {
+        fprintf(stderr, "%s is not a whole number of records\n", filename);
+        exit(1);
+    }
+    size_t rec_num = sbuf.st_size / layout.rec_size;
+    const char *recs = NULL;
+    if (rec_num > 0) {
+        recs = mmap(NULL, sbuf.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (recs == MAP_FAILED) {
+            perror("mmap");
+            exit(1);
+        }
+        madvise((void *) recs, sbuf.st_size, MADV_SEQUENTIAL);
+    }
+    if (close(fd) == -1) {
+        perror("close");
+        exit(1);
+    }
+
+    if (thread_num < 1) {
+        thread_num = 1;
+    }
+    if ((size_t) thread_num > rec_num) {
+        thread_num = rec_num > 0 ? rec_num : 1;
+    }
+    struct scan_job jobs[thread_num];
+    pthread_t threads[thread_num];
+    for (int i = 0; i < thread_num; i++) {
+        jobs[i].recs = recs;
+        jobs[i].begin = rec_num * i / thread_num;
+        jobs[i].end = rec_num * (i + 1) / thread_num;
+        jobs[i].check_order = check_order;
+        // The calling thread scans the first range itself.
+        if (i > 0 && pthread_create(&threads[i], NULL, scan_range, &jobs[i]) != 0) {
+            fprintf(stderr, "Cannot create verifier thread\n");
+            exit(1);
+        }
+    }
+    scan_range(&jobs[0]);
+
+    result->check.sum = 0;
+    result->check.sum2 = 0;
+    result->check.rec_num = 0;
+    result->sorted = 1;
+    result->first_bad = 0;
+    for (int i = 0; i < thread_num; i++) {
+        if (i > 0 && pthread_join(threads[i], NULL) != 0) {
+            fprintf(stderr, "Cannot join verifier thread\n");
+            exit(1);
+        }
+        result->check.sum += jobs[i].result.check.sum;
+        result->check.sum2 += jobs[i].result.check.sum2;
+        result->check.rec_num += jobs[i].result.check.rec_num;
+        // Jobs are in file order, so the first failing job has the first bad record.
+        if (result->sorted && !jobs[i].result.sorted) {
+            result->sorted = 0;
+            result->first_bad = jobs[i].result.first_bad;
+        }
+    }
+    if (rec_num > 0 && munmap((void *) recs, sbuf.st_size) == -1) {
+        perror("munmap");
+        exit(1);
+    }
+}
+
+/*
+ * Check that outfile is sorted by key and holds exactly the records of infile.
+ * Print the outcome and return 0 if the check passes, 1 otherwise.
+ */
+int verify_output(char *infile, char *outfile, int thread_num) {
+    struct scan_result in_res, out_res;
+    scan_file(infile, thread_num, 0, &in_res);
+    scan_file(outfile, thread_num, 1, &out_res);
+
+    int ok = 1;
+    if (!out_res.sorted) {
+        fprintf(stderr, "%s is not sorted: record %zu is out of order\n", outfile, out_res.first_bad);
+        ok = 0;
+    }
+    if (in_res.check.rec_num != out_res.check.rec_num) {
+        fprintf(stderr, "%s has %zu records but %s has %zu\n", infile, in_res.check.rec_num,
+                outfile, out_res.check.rec_num);
+        ok = 0;
+    } else if (in_res.check.sum != out_res.check.sum || in_res.check.sum2 != out_res.check.sum2) {
+        fprintf(stderr, "%s is not a permutation of %s: checksums differ\n", outfile, infile);
+        ok = 0;
+    }
+    if (ok) {
+        printf("OK: %zu records sorted, checksum %016llx%016llx\n", out_res.check.rec_num,
+               (unsigned long long) out_res.check.sum, (unsigned long long) out_res.check.sum2);
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,24 @@
+#ifndef _VERIFY_H
+#define _VERIFY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Order-independent checksum of a multiset of records. */
+struct checksum {
+    uint64_t sum;   /* sum of per-record hashes */
+    uint64_t sum2;  /* sum of a second, independently seeded per-record hash */
+    size_t rec_num;
+};
+
+/* Result of scanning one mmapped file of records. */
+struct scan_result {
+    struct checksum check;
+    int sorted;          /* 1 if every record is ordered by key after its predecessor */
+    size_t first_bad;    /* index of the first out-of-order record when sorted is 0 */
+};
+
+void scan_file(char *filename, int thread_num, int check_order, struct scan_result *result);
+int verify_output(char *infile, char *outfile, int thread_num);
+
+#endif /* _VERIFY_H */
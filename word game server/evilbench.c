@@ -0,0 +1,177 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <malloc.h>
+
+#include "gameplay.h"
+#include "util.h"
+
+/* This program hosts many evil games at once, as the server would with one
+ * room per game, and plays them in turn one guess at a time with random
+ * guessers, through the same gameplay functions as wordsrv. It reports the
+ * memory each room needs and how long guesses and new games take, so the
+ * engine can be checked against the latency budget of the server loop: a
+ * loop that serves one guess in every room takes the "pass" time.
+ * The report goes to stderr, apart from the server's log on stdout.
+ *
+ *   -n rooms     number of rooms (default 1000)
+ *   -g games     games each room plays (default 3)
+ *   -b us        latency budget of one guess in microseconds (default 1000)
+ *   -r seed      seed of random (default 1)
+ *
+ * Usage: evilbench [options] <dictionary filename>
+ *
+ * To compile the program:
+ *          make evilbench
+ */
+
+#define DEFAULT_ROOMS 1000
+#define DEFAULT_GAMES 3
+#define DEFAULT_BUDGET_US 1000
+
+
+/* Return the number of bytes of heap in use. */
+static size_t heap_in_use(void) {
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+}
+
+
+/* Sort the n times in ns and print their percentiles in microseconds. */
+static void print_times(char *what, long *ns, long n) {
+    qsort(ns, n, sizeof(long), compare_longs);
+    fprintf(stderr, "%-10s %9ld %9.1f %9.1f %9.1f %9.1f\n", what, n, ns[n / 2] / 1e3,
+                   ns[n * 9 / 10] / 1e3, ns[n * 99 / 100] / 1e3, ns[n - 1] / 1e3);
+}
+
+
+int main(int argc, char **argv) {
+    int num_rooms = DEFAULT_ROOMS, num_games = DEFAULT_GAMES;
+    long budget_ns = DEFAULT_BUDGET_US * 1000L;
+    unsigned int seed = 1;
+    int opt;
+
+    while((opt = getopt(argc, argv, "n:g:b:r:")) != -1) {
+        switch(opt) {
+        case 'n':
+            num_rooms = strtol(optarg, NULL, 10);
+            break;
+        case 'g':
+            num_games = strtol(optarg, NULL, 10);
+            break;
+        case 'b':
+            budget_ns = strtol(optarg, NULL, 10) * 1000L;
+            break;
+        case 'r':
+            seed = strtoul(optarg, NULL, 10);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-n rooms] [-g games] [-b us] [-r seed] "
+                    "<dictionary filename>\n", argv[0]);
+            exit(1);
+        }
+    }
+    if(optind != argc - 1 || num_rooms < 1 || num_games < 1) {
+        fprintf(stderr, "Usage: %s [-n rooms] [-g games] [-b us] [-r seed] "
+                "<dictionary filename>\n", argv[0]);
+        exit(1);
+    }
+    srandom(seed);
+
+    // The engine is shared; everything allocated after it belongs to the rooms
+    long start = now_ns();
+    struct evil_engine *evil = init_evil_engine(load_word_list(argv[optind], 1, MAX_WORD - 1,
+                                                               ANY_DIFFICULTY));
+    long engine_ns = now_ns() - start;
+
+    size_t heap_before = heap_in_use();
+    struct game_state *rooms = calloc(num_rooms, sizeof(struct game_state));
+    int *games_left = malloc(num_rooms * sizeof(int));
+    if(rooms == NULL || games_left == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+    for(int r = 0; r < num_rooms; r++) {
+        init_evil_game(&rooms[r], evil);
+    }
+    size_t room_bytes = heap_in_use() - heap_before;
+
+    // A game has at most one guess per letter
+    long max_guesses = (long) num_rooms * num_games * NUM_LETTERS;
+    long *guess_ns = malloc(max_guesses * sizeof(long));
+    long *new_game_ns = malloc((long) num_rooms * num_games * sizeof(long));
+    if(guess_ns == NULL || new_game_ns == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+    long num_guesses = 0, num_new_games = 0, over_budget = 0, wins = 0;
+    long worst_pass_ns = 0, passes = 0;
+
+    long bench_start = now_ns();
+    for(int r = 0; r < num_rooms; r++) {
+        start = now_ns();
+        init_game(&rooms[r]);
+        new_game_ns[num_new_games++] = now_ns() - start;
+        games_left[r] = num_games;
+    }
+    for(int live = num_rooms; live > 0; ) {
+        long pass_start = now_ns();
+        live = 0;
+        for(int r = 0; r < num_rooms; r++) {
+            struct game_state *game = &rooms[r];
+            if(games_left[r] == 0) {
+                continue;
+            }
+            int c;
+            do {
+                c = random() % NUM_LETTERS;
+            } while(game->letters_guessed[c]);
+
+            start = now_ns();
+            play_letter(game, 'a' + c);
+            long ns = now_ns() - start;
+            guess_ns[num_guesses++] = ns;
+            over_budget += ns > budget_ns;
+
+            int win = strchr(game->guess, '-') == NULL;
+            if(win || game->guesses_left <= 0) {
+                wins += win;
+                if(--games_left[r] > 0) {
+                    start = now_ns();
+                    init_game(game);
+                    new_game_ns[num_new_games++] = now_ns() - start;
+                }
+            }
+            live += games_left[r] > 0;
+        }
+        long pass_ns = now_ns() - pass_start;
+        if(pass_ns > worst_pass_ns) {
+            worst_pass_ns = pass_ns;
+        }
+        passes++;
+    }
+    double seconds = (now_ns() - bench_start) / 1e9;
+
+    fprintf(stderr, "%d rooms, %d games each, %d wrong guesses allowed\n", num_rooms, num_games,
+                   MAX_GUESSES);
+    fprintf(stderr, "engine built in %.1f ms; %.0f bytes per room (%zu bytes of game_state)\n",
+                   engine_ns / 1e6, (double) room_bytes / num_rooms, sizeof(struct game_state));
+    fprintf(stderr, "%.1f%% won, %.0f guesses/s, %ld passes, worst pass %.2f ms\n",
+                   100.0 * wins / ((long) num_rooms * num_games), num_guesses / seconds, passes,
+                   worst_pass_ns / 1e6);
+    fprintf(stderr, "%ld guesses (%.3f%%) over the budget of %ld us\n", over_budget,
+                   100.0 * over_budget / num_guesses, budget_ns / 1000);
+    fprintf(stderr, "%-10s %9s %9s %9s %9s %9s\n", "us", "count", "p50", "p90", "p99", "max");
+    print_times("guess", guess_ns, num_guesses);
+    print_times("new game", new_game_ns, num_new_games);
+
+    for(int r = 0; r < num_rooms; r++) {
+        deallocate_candset(&rooms[r].set);
+    }
+    free(rooms);
+    free(games_left);
+    free(guess_ns);
+    free(new_game_ns);
+    return 0;
+}
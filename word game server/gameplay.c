@@ -25,48 +25,171 @@ char *status_message(char *msg, struct game_state *game) {
 }
 
 
-/* Initialize the gameboard: 
- *    - initialize dictionary
- *    - select a random word to guess from the dictionary file
- *    - set guess to all dashes ('-')
- *    - initialize the other fields
- * We can't initialize head and has_next_turn because these will have
- * different values when we use init_game to create a new game after one
- * has already been played
+/* Return the difficulty of word, by the number of different letters in it.
  */
-void init_game(struct game_state *game, char *dict_name) {
-    char buf[MAX_WORD];
-    if(game->dict.fp != NULL) {
-        rewind(game->dict.fp);
-    } else {
-        game->dict.fp = fopen(dict_name, "r");
-        if(game->dict.fp == NULL) {
-            perror("Opening dictionary");
-            exit(1);
+enum difficulty get_difficulty(char *word) {
+    int seen[NUM_LETTERS] = {0};
+    int letters = 0;
+    for(char *c = word; *c != '\0'; c++) {
+        if(*c >= 'a' && *c <= 'z' && !seen[*c - 'a']) {
+            seen[*c - 'a'] = 1;
+            letters++;
         }
-    } 
+    }
+    if(letters >= EASY_LETTERS) {
+        return EASY;
+    }
+    return letters <= HARD_LETTERS ? HARD : MEDIUM;
+}
 
-    int index = random() % game->dict.size;
-    printf("Looking for word at index %d\n", index);
-    for(int i = 0; i <= index; i++) {
-        if(!fgets(buf, MAX_WORD, game->dict.fp)){
-            fprintf(stderr,"File ended before we found the entry index %d",index);
-            exit(1);
+
+/* Load the dictionary in dict_name, text or image, and list the words of
+ * min_length to max_length letters of the given difficulty (any if
+ * ANY_DIFFICULTY). Words longer than a game's word are never listed.
+ * The words of each length are one range of indexes of the dictionary,
+ * so only the words of the lengths asked for are looked at.
+ */
+struct dict_file *load_word_list(char *dict_name, int min_length, int max_length,
+                                 enum difficulty difficulty) {
+    struct dict_file *dict = malloc(sizeof(struct dict_file));
+    if(dict == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+    dict->words = load_dictionary(dict_name);
+    if(max_length > dict->words->max_length) {
+        max_length = dict->words->max_length;
+    }
+    if(max_length > MAX_WORD - 1) {
+        max_length = MAX_WORD - 1;
+    }
+    dict->min_length = min_length < 1 ? 1 : min_length;
+    dict->max_length = max_length;
+
+    int first = 0, end = 0;
+    if(dict->min_length <= dict->max_length) {
+        first = dict->words->buckets[dict->min_length];
+        end = dict->words->buckets[dict->max_length + 1];
+    }
+    dict->choices = malloc((end - first + 1) * sizeof(int));
+    if(dict->choices == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+    dict->num_choices = 0;
+    for(int i = first; i < end; i++) {
+        if(difficulty == ANY_DIFFICULTY || get_difficulty(get_word(dict->words, i)) == difficulty) {
+            dict->choices[dict->num_choices++] = i;
         }
-    } 
+    }
+    if(dict->num_choices == 0) {
+        fprintf(stderr, "The dictionary has no words of the length and difficulty asked for\n");
+        exit(1);
+    }
+    return dict;
+}
 
-    // Found word
-    if(buf[strlen(buf) - 1] == '\n') {  // from a unix file
-        buf[strlen(buf) - 1] = '\0';
-    } else {
-        fprintf(stderr, "The dictionary file does not appear to have Unix line endings\n");
+
+/* Build the indexes that evil games are played over from the dictionary
+ * of dict. Games are played at the lengths of dict.
+ */
+struct evil_engine *init_evil_engine(struct dict_file *dict) {
+    struct evil_engine *evil = malloc(sizeof(struct evil_engine));
+    if(evil == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+    evil->dict = dict;
+    evil->index = build_word_index(dict->words);
+    evil->bits = build_bit_index(evil->index);
+    init_candset_scratch(&evil->scratch, evil->bits);
+    evil->playable = 0;
+    for(int len = dict->min_length; len <= dict->max_length; len++) {
+        if(evil->bits->groups[len].positions != NULL) {
+            evil->playable += evil->bits->groups[len].words->num_words;
+        }
     }
-    strncpy(game->word, buf, MAX_WORD);
-    game->word[MAX_WORD-1] = '\0';
+    if(evil->playable == 0) {
+        fprintf(stderr, "The dictionary has no words of the lengths asked for\n");
+        exit(1);
+    }
+    return evil;
+}
+
+/* Return an engine that plays with the dictionary and indexes of evil but
+ * has scratch space of its own, for the games of another thread.
+ */
+struct evil_engine *share_evil_engine(struct evil_engine *evil) {
+    struct evil_engine *shared = malloc(sizeof(struct evil_engine));
+    if(shared == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+    *shared = *evil;
+    init_candset_scratch(&shared->scratch, shared->bits);
+    return shared;
+}
+
+
+/* Make game an evil game played with evil. Its candidate set is allocated
+ * here, once, so starting new games allocates nothing.
+ */
+void init_evil_game(struct game_state *game, struct evil_engine *evil) {
+    game->evil = evil;
+    init_candset(&game->set, evil->bits);
+}
+
+
+/* Start an evil game: pick a length, weighted by the number of words of
+ * each length, and make every word of that length a candidate.
+ */
+static void start_evil_game(struct game_state *game) {
+    struct bit_group *groups = game->evil->bits->groups;
+    long r = random() % game->evil->playable;
+    int len = game->evil->dict->min_length;
+    while(groups[len].positions == NULL || r >= groups[len].words->num_words) {
+        if(groups[len].positions != NULL) {
+            r -= groups[len].words->num_words;
+        }
+        len++;
+    }
+    printf("Starting an evil game with %d words of length %d\n",
+           groups[len].words->num_words, len);
+    start_candset(&game->set, &groups[len]);
+    game->word[0] = '\0';
+    strcpy(game->guess, game->set.pattern);
+}
+
+
+/* Select a random word to guess from the word list and set guess to all
+ * dashes ('-').
+ */
+static void pick_word(struct game_state *game) {
+    int index = game->dict->choices[random() % game->dict->num_choices];
+    printf("Looking for word at index %d\n", index);
+    strcpy(game->word, get_word(game->dict->words, index));
     for(int j = 0; j < strlen(game->word); j++) {
         game->guess[j] = '-';
     }
     game->guess[strlen(game->word)] = '\0';
+}
+
+
+/* Initialize the gameboard: 
+ *    - select a random word to guess from the word list, or in evil
+ *      mode, start with every word of a random length as a candidate
+ *    - set guess to all dashes ('-')
+ *    - initialize the other fields
+ * We can't initialize head and has_next_turn because these will have
+ * different values when we use init_game to create a new game after one
+ * has already been played
+ */
+void init_game(struct game_state *game) {
+    if(game->evil != NULL) {
+        start_evil_game(game);
+    } else {
+        pick_word(game);
+    }
 
     for(int i = 0; i < NUM_LETTERS; i++) {
         game->letters_guessed[i] = 0;
@@ -76,21 +199,30 @@ void init_game(struct game_state *game, char *dict_name) {
 }
 
 
-/* Return the number of lines in the file
+/* Guess letter, which must not have been guessed yet: reveal it in guess
+ * and use up a guess if it is not in the word. In evil mode the engine
+ * answers with the biggest family of candidates, and once the game is over
+ * word is set to one of the candidates left.
+ * Return 1 if the letter is in the word and 0 otherwise.
  */
-int get_file_length(char *filename) {
-    char buf[MAX_MSG];
-    int count = 0;
-    FILE *fp;
-    if((fp = fopen(filename, "r")) == NULL) {
-        perror("open");
-        exit(1);
+int play_letter(struct game_state *game, char letter) {
+    int found = 0;
+    game->letters_guessed[letter - 'a'] = 1;
+    if(game->evil != NULL) {
+        found = partition_candset(&game->set, letter, &game->evil->scratch) != 0;
+        strcpy(game->guess, game->set.pattern);
+    } else {
+        for(int i = 0; i < strlen(game->word); i++) {
+            if(game->word[i] == letter) {
+                game->guess[i] = letter;
+                found = 1;
+            }
+        }
     }
-    
-    while(fgets(buf, MAX_MSG, fp) != NULL) {
-        count++;
+    game->guesses_left -= !found;
+
+    if(game->evil != NULL && (game->guesses_left <= 0 || strchr(game->guess, '-') == NULL)) {
+        strcpy(game->word, get_candset_word(&game->set, random() % game->set.num_words));
     }
-    
-    fclose(fp);
-    return count;
+    return found;
 }
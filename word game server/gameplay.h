@@ -1,26 +1,78 @@
+#ifndef _GAMEPLAY_H_
+#define _GAMEPLAY_H_
+
 #include <netinet/in.h>
+#include "reading.h"
+#include "candset.h"
 
 #define MAX_NAME 30  
 #define MAX_MSG 128
 #define MAX_WORD 20
 #define MAX_BUF 256
+#define MAX_OUTPUT 8192  // Most bytes of output a client may fall behind by
+#define MAX_QUEUED 64    // Most messages a client may fall behind by
 #define MAX_GUESSES 4
 #define NUM_LETTERS 26
 #define WELCOME_MSG "Welcome to our word game. What is your name? "
 
+// A message formatted once and queued to every client it is for. It is
+// freed when the last of them has sent it.
+struct message {
+    int refs;             // Number of queues holding the message, plus its creator
+    int len;              // Length of text, without the NUL
+    char text[];
+};
+
+struct room;
+
 struct client {
     int fd;
     struct in_addr ipaddr;
     struct client *next;
+    struct client *prev;  // The client before this one in the lobby, or NULL
     char name[MAX_NAME];
     char inbuf[MAX_BUF];  // Used to hold input from the client
     char *in_ptr;         // A pointer into inbuf to help with partial reads
+    struct message *out[MAX_QUEUED]; // Ring of messages waiting to be sent
+    int out_first;        // Position in out of the oldest message
+    int out_count;        // Number of messages waiting
+    int out_sent;         // Bytes of the oldest message already sent
+    int out_bytes;        // Bytes waiting in all
+    int watching_output;  // 1 if the socket is watched for being writable
+    int dirty;            // 1 if the client has output to flush this pass
+    struct client *next_dirty; // The next client with output to flush
+    int dead;             // 1 once the client is to be removed
+    struct client *next_dead; // The next client to be removed
+    struct room *room;    // The room the client plays in, or NULL in the lobby
 };
 
-// Information about the dictionary used to pick random word
-struct dictionary {
-    FILE *fp;
-    int size;
+// How hard a word is to guess: the fewer different letters it has, the
+// fewer chances the players have to hit one
+enum difficulty {ANY_DIFFICULTY, EASY, MEDIUM, HARD};
+#define EASY_LETTERS 7   // Different letters of an easy word, at least
+#define HARD_LETTERS 4   // Different letters of a hard word, at most
+
+// The words used to pick random word. The dictionary is loaded once, text
+// or image, and the words that pass the filters are listed by index, so
+// starting a game needs no file I/O. Games share it read-only.
+struct dict_file {
+    struct dictionary *words; // Every word of the dictionary
+    int min_length;           // Lengths games are played at
+    int max_length;
+    int *choices;             // Indexes in words of the words that may be picked
+    int num_choices;
+};
+
+// The evil hangman engine shared by every game in evil mode. The dictionary
+// and its indexes are read-only once built, so games only keep their own
+// candidate sets; the scratch space is used by one guess at a time, so
+// every thread that plays games has an engine of its own sharing the rest.
+struct evil_engine {
+    struct dict_file *dict;
+    struct word_index *index;
+    struct bit_index *bits;
+    struct candset_scratch scratch;
+    long playable;            // Number of words of the lengths games are played at
 };
 
 struct game_state {
@@ -29,13 +81,24 @@ struct game_state {
     int letters_guessed[NUM_LETTERS]; // Index i will be 1 if the corresponding
                                       // letter has been guessed; 0 otherwise
     int guesses_left;         // Number of guesses remaining
-    struct dictionary dict;
+    struct dict_file *dict;
+    struct evil_engine *evil; // The engine in evil mode, or NULL
+    struct candset set;       // In evil mode, the words that fit every answer so far;
+                              // word is only picked from them when the game ends
     
     struct client *head;
     struct client *has_next_turn;
 };
 
 
-void init_game(struct game_state *game, char *dict_name);
-int get_file_length(char *filename);
+struct dict_file *load_word_list(char *dict_name, int min_length, int max_length,
+                                 enum difficulty difficulty);
+enum difficulty get_difficulty(char *word);
+void init_game(struct game_state *game);
+int play_letter(struct game_state *game, char letter);
+struct evil_engine *init_evil_engine(struct dict_file *dict);
+struct evil_engine *share_evil_engine(struct evil_engine *evil);
+void init_evil_game(struct game_state *game, struct evil_engine *evil);
 char *status_message(char *msg, struct game_state *game);
+
+#endif
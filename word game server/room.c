@@ -0,0 +1,154 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "room.h"
+
+/*
+ * Initialize an empty pool of rooms of the given number of seats, playing
+ * with the words of dict, and evil if it is not NULL.
+ */
+void init_room_pool(struct room_pool *pool, int seats, struct dict_file *dict,
+                    struct evil_engine *evil) {
+    pool->seats = seats;
+    pool->dict = dict;
+    pool->evil = evil;
+    pool->open_rooms = NULL;
+    pool->free_rooms = NULL;
+    pool->num_rooms = 0;
+    pool->rooms_in_use = 0;
+    pool->open_seats = 0;
+}
+
+/*
+ * Add ROOM_CHUNK new rooms to the rooms not in use.
+ */
+static void grow_pool(struct room_pool *pool) {
+    struct room *rooms = calloc(ROOM_CHUNK, sizeof(struct room));
+    if (rooms == NULL) {
+        perror("calloc");
+        exit(1);
+    }
+    for (int i = ROOM_CHUNK - 1; i >= 0; i--) {
+        struct room *room = &rooms[i];
+        room->id = pool->num_rooms + i;
+        room->game.dict = pool->dict;
+        room->game.evil = NULL;
+        if (pool->evil != NULL) {
+            init_evil_game(&room->game, pool->evil);
+        }
+        room->next_open = pool->free_rooms;
+        pool->free_rooms = room;
+    }
+    pool->num_rooms += ROOM_CHUNK;
+}
+
+static void add_open_room(struct room_pool *pool, struct room *room) {
+    room->open = 1;
+    room->prev_open = NULL;
+    room->next_open = pool->open_rooms;
+    if (pool->open_rooms != NULL) {
+        pool->open_rooms->prev_open = room;
+    }
+    pool->open_rooms = room;
+}
+
+static void remove_open_room(struct room_pool *pool, struct room *room) {
+    if (room->prev_open != NULL) {
+        room->prev_open->next_open = room->next_open;
+    } else {
+        pool->open_rooms = room->next_open;
+    }
+    if (room->next_open != NULL) {
+        room->next_open->prev_open = room->prev_open;
+    }
+    room->open = 0;
+}
+
+/*
+ * Count n more free seats in the open rooms of pool.
+ */
+static void add_open_seats(struct room_pool *pool, int n) {
+    __atomic_add_fetch(&pool->open_seats, n, __ATOMIC_RELAXED);
+}
+
+/*
+ * Return a room with a free seat, opening a new one with a new game if
+ * every room in use is full.
+ */
+struct room *get_open_room(struct room_pool *pool) {
+    if (pool->open_rooms != NULL) {
+        return pool->open_rooms;
+    }
+    if (pool->free_rooms == NULL) {
+        grow_pool(pool);
+    }
+    struct room *room = pool->free_rooms;
+    pool->free_rooms = room->next_open;
+    room->num_players = 0;
+    room->game.head = NULL;
+    room->game.has_next_turn = NULL;
+    init_game(&room->game);
+    add_open_room(pool, room);
+    pool->rooms_in_use++;
+    add_open_seats(pool, pool->seats);
+    printf("Opening room %d\n", room->id);
+    return room;
+}
+
+/*
+ * Count a player who has just joined room.
+ */
+void take_seat(struct room_pool *pool, struct room *room) {
+    room->num_players++;
+    add_open_seats(pool, -1);
+    if (room->num_players == pool->seats) {
+        remove_open_room(pool, room);
+    }
+}
+
+/*
+ * Count a player who has just left room. A room nobody is left in goes
+ * back to the pool.
+ */
+void leave_seat(struct room_pool *pool, struct room *room) {
+    room->num_players--;
+    add_open_seats(pool, 1);
+    if (room->open) {
+        remove_open_room(pool, room);
+    }
+    if (room->num_players == 0) {
+        printf("Closing room %d\n", room->id);
+        room->next_open = pool->free_rooms;
+        pool->free_rooms = room;
+        pool->rooms_in_use--;
+        add_open_seats(pool, -pool->seats);
+    } else {
+        add_open_room(pool, room);
+    }
+}
+
+/*
+ * Claim a free seat in the open rooms of pool, from another thread, for a
+ * player about to be sent to pool's reactor. Return 1 if a seat was
+ * claimed, or 0 if pool had none to spare. The count is only a hint: the
+ * room may fill or close before the player arrives, and then the player
+ * is seated in a new room.
+ */
+int claim_seat(struct room_pool *pool) {
+    int seats = __atomic_load_n(&pool->open_seats, __ATOMIC_RELAXED);
+    while (seats > 0) {
+        if (__atomic_compare_exchange_n(&pool->open_seats, &seats, seats - 1, 1,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Give back the seat claimed for a player who has arrived, before seating
+ * the player with take_seat.
+ */
+void settle_claim(struct room_pool *pool) {
+    add_open_seats(pool, 1);
+}
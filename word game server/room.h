@@ -0,0 +1,47 @@
+#ifndef _ROOM_H_
+#define _ROOM_H_
+
+#include "gameplay.h"
+
+#define ROOM_SEATS 4     // Players per room, unless set with -r
+#define ROOM_CHUNK 256   // Rooms allocated at once when the pool runs out
+
+/* One game and its players. Rooms are allocated in chunks and reused, so
+ * opening a room allocates nothing once the pool has grown, and in evil
+ * mode each room keeps the candidate set it was given when allocated.
+ */
+struct room {
+    struct game_state game;   // The game, its players and its turn
+    int id;
+    int num_players;
+    int open;                 // 1 if in the list of rooms with a free seat
+    struct room *prev_open;   // Neighbours in that list, or next_open links
+    struct room *next_open;   // the list of rooms not in use
+};
+
+/* The rooms of one reactor: the rooms in use with a free seat, where the
+ * lobby seats new players, and the rooms not in use. Only the reactor's
+ * thread touches the rooms; other reactors only read open_seats, and
+ * claim a seat there for a player they send over.
+ */
+struct room_pool {
+    int seats;                // Players per room
+    struct dict_file *dict;   // The words all rooms play with
+    struct evil_engine *evil; // The engine of evil rooms, or NULL
+    struct room *open_rooms;  // Rooms in use with a free seat
+    struct room *free_rooms;  // Rooms not in use
+    int num_rooms;            // Rooms allocated
+    int rooms_in_use;
+    int open_seats;           // Free seats in open rooms, less the seats claimed
+                              // by other reactors; read and written atomically
+};
+
+void init_room_pool(struct room_pool *pool, int seats, struct dict_file *dict,
+                    struct evil_engine *evil);
+struct room *get_open_room(struct room_pool *pool);
+void take_seat(struct room_pool *pool, struct room *room);
+void leave_seat(struct room_pool *pool, struct room *room);
+int claim_seat(struct room_pool *pool);
+void settle_claim(struct room_pool *pool);
+
+#endif
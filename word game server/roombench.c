@@ -0,0 +1,310 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "util.h"
+
+/* This program measures how wordsrv scales with the number of rooms. For
+ * each room count given, it starts a server, fills that many rooms with
+ * bots that guess a random letter whenever it is their turn, and plays
+ * for a while. It reports the server's CPU time per room and per guess
+ * (from /proc/<pid>/stat) and the latency of a guess: the time from a bot
+ * sending its guess to the first byte of the answer. The bots guess as
+ * soon as they are asked, so enough rooms keep the server busy, and then
+ * latency grows with the number of rooms waiting their turn.
+ *
+ *   -s seats     players per room (default 4)
+ *   -t seconds   time each room count is played for (default 5)
+ *   -e           play evil games
+ *   -n threads   reactor threads of the server (default: the server's own)
+ *   -w server    the server to run (default ./wordsrv)
+ *
+ * Usage: roombench [options] <dictionary filename> <rooms>...
+ *
+ * To compile the program:
+ *          make roombench
+ */
+
+#ifndef PORT
+    #define PORT 51250
+#endif
+#define DEFAULT_SEATS 4
+#define DEFAULT_SECONDS 5
+#define MAX_EVENTS 256
+#define TAIL 16   // Bytes of input kept to find prompts split between reads
+
+struct bot {
+    int fd;
+    char tail[TAIL + 1];   // The end of the last input
+    long sent_ns;          // When the guess being answered was sent, or 0
+};
+
+
+/* Return the CPU time process pid has used, in seconds. */
+static double cpu_seconds(pid_t pid) {
+    char name[64], buf[1024];
+    snprintf(name, sizeof(name), "/proc/%d/stat", (int) pid);
+    FILE *fp = fopen(name, "r");
+    if (fp == NULL) {
+        perror(name);
+        exit(1);
+    }
+    if (fgets(buf, sizeof(buf), fp) == NULL) {
+        fprintf(stderr, "Could not read %s\n", name);
+        exit(1);
+    }
+    fclose(fp);
+    // utime and stime are fields 14 and 15; the command name may hold spaces
+    char *p = strrchr(buf, ')');
+    unsigned long utime, stime;
+    if (p == NULL || sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu",
+                            &utime, &stime) != 2) {
+        fprintf(stderr, "Could not parse %s\n", name);
+        exit(1);
+    }
+    return (double) (utime + stime) / sysconf(_SC_CLK_TCK);
+}
+
+
+/* Start the server and return its pid. Its log goes to /dev/null. threads
+ * is 0 to leave the number of reactor threads to the server.
+ */
+static pid_t start_server(char *server, char *dict_name, int seats, int evil, int threads) {
+    char seats_arg[16], threads_arg[16];
+    snprintf(seats_arg, sizeof(seats_arg), "%d", seats);
+    snprintf(threads_arg, sizeof(threads_arg), "%d", threads);
+    char *args[] = {server, "-r", seats_arg, "-q", "4096", NULL, NULL, NULL, NULL, NULL};
+    int n = 5;
+    if (evil) {
+        args[n++] = "-e";
+    }
+    if (threads > 0) {
+        args[n++] = "-t";
+        args[n++] = threads_arg;
+    }
+    args[n] = dict_name;
+    pid_t pid = fork();
+    if (pid == -1) {
+        perror("fork");
+        exit(1);
+    }
+    if (pid == 0) {
+        int null = open("/dev/null", O_WRONLY);
+        if (null == -1) {
+            perror("/dev/null");
+            exit(1);
+        }
+        dup2(null, STDOUT_FILENO);
+        dup2(null, STDERR_FILENO);
+        execv(server, args);
+        perror(server);
+        exit(1);
+    }
+    return pid;
+}
+
+
+/* Connect to the server, retrying while it starts up, and return the
+ * socket.
+ */
+static int connect_bot(void) {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(PORT);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    for (int tries = 0; tries < 100; tries++) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd == -1) {
+            perror("socket");
+            exit(1);
+        }
+        if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) == 0) {
+            return fd;
+        }
+        close(fd);
+        usleep(50000);
+    }
+    perror("connect");
+    exit(1);
+}
+
+
+/* Send the line text to bot b; the server's input is small enough that
+ * the socket always takes it.
+ */
+static void send_line(struct bot *b, char *text) {
+    int len = strlen(text);
+    if (write(b->fd, text, len) != len) {
+        perror("write");
+        exit(1);
+    }
+}
+
+
+/* Send a random letter as bot b's guess. */
+static void guess(struct bot *b) {
+    char line[4] = {'a' + random() % 26, '\r', '\n', '\0'};
+    b->sent_ns = now_ns();
+    send_line(b, line);
+}
+
+
+/* Play num_rooms rooms of seats bots for seconds and print a report line. */
+static void run(char *server, char *dict_name, int num_rooms, int seats, int evil,
+                int threads, int seconds) {
+    pid_t pid = start_server(server, dict_name, seats, evil, threads);
+    int num_bots = num_rooms * seats;
+    struct bot *bots = calloc(num_bots, sizeof(struct bot));
+    int max_latencies = 1 << 20;
+    long *latencies = malloc(max_latencies * sizeof(long));
+    if (bots == NULL || latencies == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+    int epfd = epoll_create1(0);
+    if (epfd == -1) {
+        perror("epoll_create1");
+        exit(1);
+    }
+
+    // The lobby seats players in the order their names arrive, so the bots
+    // fill the rooms one after another
+    for (int i = 0; i < num_bots; i++) {
+        struct bot *b = &bots[i];
+        b->fd = connect_bot();
+        char name[32];
+        snprintf(name, sizeof(name), "bot%d\r\n", i);
+        send_line(b, name);
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.ptr = b;
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, b->fd, &ev) == -1) {
+            perror("epoll_ctl");
+            exit(1);
+        }
+    }
+
+    long num_latencies = 0, guesses = 0;
+    double cpu_start = 0;
+    long start = now_ns(), measure_start = 0, end = start + (seconds + 1) * 1000000000L;
+    struct epoll_event events[MAX_EVENTS];
+    char buf[4096];
+    while (now_ns() < end) {
+        if (measure_start == 0 && now_ns() - start > 1000000000L) {
+            // Measure from one second in, once every bot is seated
+            measure_start = now_ns();
+            cpu_start = cpu_seconds(pid);
+            num_latencies = guesses = 0;
+        }
+        int nready = epoll_wait(epfd, events, MAX_EVENTS, 100);
+        for (int i = 0; i < nready; i++) {
+            struct bot *b = events[i].data.ptr;
+            int n = read(b->fd, buf, sizeof(buf) - 1);
+            if (n <= 0) {
+                fprintf(stderr, "roombench: the server closed a connection\n");
+                exit(1);
+            }
+            buf[n] = '\0';
+            if (b->sent_ns != 0) {
+                if (num_latencies < max_latencies) {
+                    latencies[num_latencies++] = now_ns() - b->sent_ns;
+                }
+                guesses++;
+                b->sent_ns = 0;
+            }
+            // Look for prompts in the input, including any split from the last read
+            char text[TAIL + sizeof(buf)];
+            snprintf(text, sizeof(text), "%s%s", b->tail, buf);
+            if (strstr(text, "Your guess?") != NULL || strstr(text, "has been guessed") != NULL) {
+                guess(b);
+                b->tail[0] = '\0';
+            } else {
+                int len = strlen(text);
+                strcpy(b->tail, text + (len > TAIL ? len - TAIL : 0));
+            }
+        }
+    }
+    double wall = (now_ns() - measure_start) / 1e9;
+    double cpu = cpu_seconds(pid) - cpu_start;
+
+    qsort(latencies, num_latencies, sizeof(long), compare_longs);
+    printf("%7d %7d %10.0f %8.1f %13.1f %10.1f %9.1f %9.1f %9.1f\n", num_rooms, num_bots,
+           guesses / wall, 100.0 * cpu / wall, 1e6 * cpu / wall / num_rooms,
+           guesses > 0 ? 1e6 * cpu / guesses : 0.0,
+           num_latencies ? latencies[num_latencies / 2] / 1e3 : 0.0,
+           num_latencies ? latencies[num_latencies * 99 / 100] / 1e3 : 0.0,
+           num_latencies ? latencies[num_latencies - 1] / 1e3 : 0.0);
+    fflush(stdout);
+
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+    for (int i = 0; i < num_bots; i++) {
+        close(bots[i].fd);
+    }
+    close(epfd);
+    free(bots);
+    free(latencies);
+}
+
+
+int main(int argc, char **argv) {
+    int seats = DEFAULT_SEATS, seconds = DEFAULT_SECONDS, evil = 0, threads = 0;
+    char *server = "./wordsrv";
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:t:en:w:")) != -1) {
+        switch (opt) {
+        case 's':
+            seats = strtol(optarg, NULL, 10);
+            break;
+        case 't':
+            seconds = strtol(optarg, NULL, 10);
+            break;
+        case 'e':
+            evil = 1;
+            break;
+        case 'n':
+            threads = strtol(optarg, NULL, 10);
+            break;
+        case 'w':
+            server = optarg;
+            break;
+        default:
+            optind = argc;
+        }
+    }
+    if (argc - optind < 2 || seats < 1 || seconds < 1 || threads < 0) {
+        fprintf(stderr, "Usage: %s [-s seats] [-t seconds] [-e] [-n threads] [-w server] "
+                "<dictionary filename> <rooms>...\n", argv[0]);
+        exit(1);
+    }
+
+    // Every bot and every server connection needs a descriptor
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+    signal(SIGPIPE, SIG_IGN);
+    srandom(1);
+
+    printf("%d players per room, %s games, %d s per room count\n", seats,
+           evil ? "evil" : "normal", seconds);
+    printf("%7s %7s %10s %8s %13s %10s %9s %9s %9s\n", "rooms", "bots", "guesses/s", "cpu %",
+           "cpu us/room/s", "cpu us/guess", "p50 us", "p99 us", "max us");
+    for (int i = optind + 1; i < argc; i++) {
+        run(server, argv[optind], strtol(argv[i], NULL, 10), seats, evil, threads, seconds);
+    }
+    return 0;
+}
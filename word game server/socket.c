@@ -1,10 +1,14 @@
+#define _GNU_SOURCE  /* accept4 */
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <arpa/inet.h>     /* inet_ntoa */
 #include <netdb.h>         /* gethostname */
 #include <sys/socket.h>
+#include <netinet/tcp.h>    /* TCP_NODELAY */
 
 #include "socket.h"
 
@@ -31,9 +35,11 @@ struct sockaddr_in *init_server_addr(int port) {
 
 
 /*
- * Create and set up a socket for a server to listen on.
+ * Create and set up a socket for a server to listen on. If share_port is
+ * set, other sockets set up the same way may listen on the port too, and
+ * the kernel spreads the new connections over them.
  */
-int set_up_server_socket(struct sockaddr_in *self, int num_queue) {
+int set_up_server_socket(struct sockaddr_in *self, int num_queue, int share_port) {
     int soc = socket(PF_INET, SOCK_STREAM, 0);
     if (soc < 0) {
         perror("socket");
@@ -49,6 +55,10 @@ int set_up_server_socket(struct sockaddr_in *self, int num_queue) {
         perror("setsockopt");
         exit(1);
     }
+    if (share_port && setsockopt(soc, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) < 0) {
+        perror("setsockopt");
+        exit(1);
+    }
 
     // Associate the process with the address and a port
     if (bind(soc, (struct sockaddr *)self, sizeof(*self)) < 0) {
@@ -92,3 +102,60 @@ int accept_connection(int listenfd) {
 }
 
 
+/*
+ * Accept a pending connection on the non-blocking socket listenfd, as a
+ * non-blocking socket without Nagle's algorithm, and store the client's
+ * address in peer.
+ * Return the client's socket descriptor, or -1 once no connection is
+ * pending. When the process is out of descriptors, the connection is
+ * accepted on the descriptor *spare_fd keeps in reserve and closed at once,
+ * so the queue keeps draining and the client is not left waiting; the
+ * reserve is then opened again. Terminate with exit code 1 on any other
+ * error.
+ */
+int accept_nonblocking(int listenfd, struct sockaddr_in *peer, int *spare_fd) {
+    while (1) {
+        socklen_t peer_len = sizeof(*peer);
+        int client_socket = accept4(listenfd, (struct sockaddr *)peer, &peer_len,
+                                    SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client_socket >= 0) {
+            // Output is already gathered into one write per pass of the
+            // event loop, so holding small writes back only adds a delay
+            int on = 1;
+            if (setsockopt(client_socket, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on)) < 0) {
+                perror("setsockopt");
+            }
+            return client_socket;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return -1;
+        }
+        if (errno == EMFILE || errno == ENFILE) {
+            perror("accept4");
+            if (*spare_fd == -1) {
+                *spare_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+            }
+            if (*spare_fd == -1) {
+                // Nothing to refuse it with: try again on the next wakeup
+                return -1;
+            }
+            // accept4 fails like this even when no connection is pending,
+            // so stop once the reserve finds none
+            close(*spare_fd);
+            int refused = accept(listenfd, NULL, NULL);
+            if (refused >= 0) {
+                close(refused);
+            }
+            *spare_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+            if (refused == -1) {
+                return -1;
+            }
+            continue;
+        }
+        // The connection was reset before we got to it, or a signal came
+        if (errno != ECONNABORTED && errno != EINTR) {
+            perror("accept4");
+            exit(1);
+        }
+    }
+}
@@ -4,7 +4,8 @@
 #include <netinet/in.h>    /* Internet domain header, for struct sockaddr_in */
 
 struct sockaddr_in *init_server_addr(int port);
-int set_up_server_socket(struct sockaddr_in *self, int num_queue);
+int set_up_server_socket(struct sockaddr_in *self, int num_queue, int share_port);
 int accept_connection(int listenfd);
+int accept_nonblocking(int listenfd, struct sockaddr_in *peer, int *spare_fd);
 
 #endif
@@ -6,25 +6,37 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/time.h>
+#include <sys/epoll.h>
+#include <sys/uio.h>
+#include <sys/resource.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <errno.h>
 #include <time.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
 
 
 #include "socket.h"
 #include "gameplay.h"
+#include "room.h"
 
 
 #ifndef PORT
     #define PORT 51250
 #endif
 #define MAX_QUEUE 5
+#define MAX_EVENTS 256  // Most ready descriptors handled per epoll_wait
 #define JOIN_MSG " has just joined."
 #define RETYPE_MSG "Username exists or is empty.Please enter again!"
 
 void add_player(struct client **top, int fd, struct in_addr addr);
 void remove_player(struct client **top, int fd);
+void close_player(struct client *p);
 
 /* These are some of the function prototypes that we used in our solution 
  * You are not required to write functions that match these prototypes, but
@@ -38,11 +50,86 @@ void announce_winner(struct game_state *game, struct client *winner);
 void advance_turn(struct game_state *game);
 
 
-/* The set of socket descriptors for select to monitor.
- * This is a global variable because we need to remove socket descriptors
- * from allset when a write to a socket fails.
+/* The server runs one reactor per thread. Each accepts connections on a
+ * listening socket of its own, all on the same port, and seats them in
+ * rooms of its own, so a room and its players are only ever touched by
+ * one thread and the game state needs no locks. A player is only moved
+ * to another reactor from the lobby, through that reactor's inbox.
  */
-fd_set allset;
+struct reactor {
+    int id;
+    pthread_t thread;
+    int listenfd;
+    int spare_fd;               // Kept open to refuse connections with when out
+                                // of descriptors
+    int wakefd;                 // eventfd other reactors wake this one with
+    struct client *inbox;       // Players sent by other reactors, pushed without
+                                // locks and linked through next
+    struct room_pool pool;
+    /* A list of client who have not yet entered their name: the lobby.
+     * This list is kept separate from the players of the rooms, because
+     * until the new playrs have entered a name, they should not have a turn
+     * or receive broadcast messages.  In other words, they can't play until
+     * they have a name, and then they are seated in a room. It is linked
+     * both ways, through next and prev, so a client leaves it in O(1).
+     */
+    struct client *new_players;
+};
+
+struct reactor *reactors;
+int num_reactors;
+
+/* The epoll instance that watches the listening socket, the wake-up
+ * eventfd and every client of this thread's reactor. Each client is
+ * registered with a pointer to its struct client as the event data, so
+ * a ready client is found without searching the lists; the listening
+ * socket is registered with NULL, and the eventfd with the reactor.
+ * This is a global variable because we need to stop watching a socket
+ * when its client is removed. Like the lists below, each thread has its
+ * own.
+ */
+__thread int epfd;
+
+/* The clients to be removed at the end of this pass of the event loop.
+ * A client that fails is only marked dead when it fails, because the
+ * caller may be walking a list of clients or hold events for it.
+ */
+__thread struct client *dead_clients = NULL;
+
+/* The clients with output queued in this pass of the event loop. Output
+ * is only written at the end of the pass, so everything a client is sent
+ * in one pass goes out in a single writev.
+ */
+__thread struct client *dirty_clients = NULL;
+
+
+/* Return a new message with the text format makes from the arguments, as
+ * printf would. The caller holds the one reference to it.
+ */
+struct message *new_message(const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(NULL, 0, format, args);
+    va_end(args);
+    struct message *m = malloc(sizeof(struct message) + len + 1);
+    if (!m) {
+        perror("malloc");
+        exit(1);
+    }
+    va_start(args, format);
+    vsnprintf(m->text, len + 1, format, args);
+    va_end(args);
+    m->refs = 1;
+    m->len = len;
+    return m;
+}
+
+/* Drop a reference to message m, freeing it if it was the last. */
+void release_message(struct message *m) {
+    if (--m->refs == 0) {
+        free(m);
+    }
+}
 
 
 /* Add a client to the head of the linked list
@@ -60,12 +147,22 @@ void add_player(struct client **top, int fd, struct in_addr addr) {
     p->name[0] = '\0';
     p->in_ptr = p->inbuf;
     p->inbuf[0] = '\0';
+    p->out_first = 0;
+    p->out_count = 0;
+    p->out_sent = 0;
+    p->out_bytes = 0;
+    p->watching_output = 0;
+    p->dirty = 0;
+    p->next_dirty = NULL;
+    p->dead = 0;
+    p->next_dead = NULL;
+    p->room = NULL;
     p->next = *top;
     *top = p;
 }
 
 /* Removes client from the linked list and closes its socket.
- * Also removes socket descriptor from allset 
+ * Also stops watching the socket descriptor with epfd
  */
 void remove_player(struct client **top, int fd) {
     struct client **p;
@@ -76,10 +173,7 @@ void remove_player(struct client **top, int fd) {
     // This avoids a special case for removing the head of the list
     if (*p) {
         struct client *t = (*p)->next;
-        printf("Removing client %d %s\n", fd, inet_ntoa((*p)->ipaddr));
-        FD_CLR((*p)->fd, &allset);
-        close((*p)->fd);
-        free(*p);
+        close_player(*p);
         *p = t;
     } else {
         fprintf(stderr, "Trying to remove fd %d, but I don't know about it\n",
@@ -87,19 +181,153 @@ void remove_player(struct client **top, int fd) {
     }
 }
 
+/* Closes the socket of p, who is in no list, and frees it.
+ * Also stops watching the socket descriptor with epfd
+ */
+void close_player(struct client *p) {
+    printf("Removing client %d %s\n", p->fd, inet_ntoa(p->ipaddr));
+    if (epoll_ctl(epfd, EPOLL_CTL_DEL, p->fd, NULL) == -1) {
+        perror("epoll_ctl");
+        exit(1);
+    }
+    close(p->fd);
+    for (int i = 0; i < p->out_count; i++) {
+        release_message(p->out[(p->out_first + i) % MAX_QUEUED]);
+    }
+    free(p);
+}
+
+/* Mark client p to be removed at the end of this pass of the event loop.
+ * Nothing more is sent to it.
+ */
+void drop_client(struct client *p) {
+    if (!p->dead) {
+        p->dead = 1;
+        p->next_dead = dead_clients;
+        dead_clients = p;
+    }
+}
+
+/* Watch p's socket for being writable as well as readable if on is 1, or
+ * only for being readable if on is 0.
+ */
+void watch_output(struct client *p, int on) {
+    if (p->watching_output == on) {
+        return;
+    }
+    struct epoll_event ev;
+    ev.events = on ? EPOLLIN | EPOLLOUT : EPOLLIN;
+    ev.data.ptr = p;
+    if (epoll_ctl(epfd, EPOLL_CTL_MOD, p->fd, &ev) == -1) {
+        perror("epoll_ctl");
+        exit(1);
+    }
+    p->watching_output = on;
+}
+
+/* Add p to the clients whose output is flushed at the end of this pass. */
+void mark_dirty(struct client *p) {
+    if (!p->dirty) {
+        p->dirty = 1;
+        p->next_dirty = dirty_clients;
+        dirty_clients = p;
+    }
+}
+
+/* Queue message m to be sent to client p. A client that falls more than
+ * MAX_QUEUED messages or MAX_OUTPUT bytes behind is dropped, so a client
+ * that stops reading never holds up the others.
+ */
+void queue_message(struct client *p, struct message *m) {
+    if (p->dead) {
+        return;
+    }
+    if (p->out_count == MAX_QUEUED || p->out_bytes + m->len > MAX_OUTPUT) {
+        fprintf(stderr, "Client %s is too far behind\n", inet_ntoa(p->ipaddr));
+        drop_client(p);
+        return;
+    }
+    m->refs++;
+    p->out[(p->out_first + p->out_count) % MAX_QUEUED] = m;
+    p->out_count++;
+    p->out_bytes += m->len;
+    mark_dirty(p);
+}
+
+/* Send the string msg to client p. */
+void send_to(struct client *p, char *msg) {
+    struct message *m = new_message("%s", msg);
+    queue_message(p, m);
+    release_message(m);
+}
+
+/* Write as much of p's queued output as its non-blocking socket takes, in
+ * one writev. If some is left, watch the socket for being writable, so
+ * the rest goes when the client catches up.
+ */
+void flush_output(struct client *p) {
+    struct iovec iov[MAX_QUEUED];
+    for (int i = 0; i < p->out_count; i++) {
+        struct message *m = p->out[(p->out_first + i) % MAX_QUEUED];
+        int skip = i == 0 ? p->out_sent : 0;
+        iov[i].iov_base = m->text + skip;
+        iov[i].iov_len = m->len - skip;
+    }
+    int n = writev(p->fd, iov, p->out_count);
+    if (n == -1) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            fprintf(stderr, "Write to client %s failed: %s\n", inet_ntoa(p->ipaddr),
+                    strerror(errno));
+            drop_client(p);
+            return;
+        }
+        n = 0;
+    }
+    p->out_bytes -= n;
+    while (p->out_count > 0 && n > 0) {
+        struct message *m = p->out[p->out_first];
+        int left = m->len - p->out_sent;
+        if (n < left) {
+            p->out_sent += n;
+            break;
+        }
+        n -= left;
+        release_message(m);
+        p->out_first = (p->out_first + 1) % MAX_QUEUED;
+        p->out_count--;
+        p->out_sent = 0;
+    }
+    watch_output(p, p->out_count > 0);
+}
+
+/* Flush the output of every client that was queued some in this pass. */
+void flush_clients(void) {
+    while (dirty_clients != NULL) {
+        struct client *p = dirty_clients;
+        dirty_clients = p->next_dirty;
+        p->dirty = 0;
+        if (!p->dead && p->out_count > 0) {
+            flush_output(p);
+        }
+    }
+}
+
 /*
- * write message to every client's fd.
+ * queue message m to every client.
  */
-void broadcast(struct game_state *game, char *outbuf){
+void broadcast_message(struct game_state *game, struct message *m){
 	for(struct client *every_p = game->head;
 		every_p != NULL;  every_p = every_p->next){
-			if(write(every_p->fd, outbuf, strlen(outbuf)) != strlen(outbuf)){
-				perror("broadcast");
-				exit(1);
-			}
-        }
-
+			queue_message(every_p, m);
+	}
+	release_message(m);
+}
 
+/*
+ * send message to every client. The message is copied once for all of them.
+ */
+void broadcast(struct game_state *game, char *outbuf){
+	broadcast_message(game, new_message("%s", outbuf));
 }
 
 /*
@@ -114,26 +342,19 @@ void announce_game_state(struct game_state *game){
  * announce the player that will take the next turn.
  */
 void announce_turn(struct game_state *game){
-	char turn_msg[MAX_MSG];
+	struct message *your_turn = new_message("Your guess?\n");
+	struct message *turn_msg = new_message("It's %s's turn.\n", game->has_next_turn->name);
 	for(struct client* every_p = game->head; every_p != NULL; every_p = every_p->next){
 		if(game->has_next_turn == every_p){
 			// ask the playing taking the turn for the guess
-			if(write(every_p->fd, "Your guess?\n", strlen("Your guess?\n")) != strlen("Your guess?\n")){
-				perror("announce turn");
-				exit(1);
-			}
+			queue_message(every_p, your_turn);
 		}else{
 			// tell other players with the name of player who takes next turn
-			turn_msg[0] = '\0';
-			strcat(turn_msg, "It's ");
-			strcat(turn_msg, game->has_next_turn->name);
-			strcat(turn_msg, "'s turn.\n");
-			if(write(every_p->fd, turn_msg, strlen(turn_msg)) != strlen(turn_msg)){
-				perror("announce turn");
-				exit(1);
-			}
+			queue_message(every_p, turn_msg);
 		}
 	}
+	release_message(your_turn);
+	release_message(turn_msg);
 	printf("It's %s's turn.\n", game->has_next_turn->name);
 }
 
@@ -141,26 +362,17 @@ void announce_turn(struct game_state *game){
  * After someone wins the game, announce who the winner is and begin a new game.
  */
 void announce_winner(struct game_state *game, struct client *winner){
-	// send message to players
-	char  win_msg[MAX_MSG];
-	strcpy(win_msg, "The word was ");
-	strcat(win_msg, game->word);
-	strcat(win_msg, ".\nGame over!");
-	broadcast(game, win_msg);
+	// send message to players: one for the winner and one for the rest
+	struct message *win_msg = new_message("The word was %s.\nGame over! You win!\n\n"
+		"Let's start a new game\n", game->word);
+	struct message *lose_msg = new_message("The word was %s.\nGame over!%s won!\n\n\n"
+		"Let's start a new game\n", game->word, winner->name);
 	for(struct client *every_p = game->head;
         every_p != NULL;  every_p = every_p->next){
-		if(every_p == winner){
-			strcpy(win_msg, " You win!\n\n");
-		}else{
-			strcpy(win_msg, winner->name);
-			strcat(win_msg, " won!\n\n\n");
-		}
-		if(write(every_p->fd, win_msg, strlen(win_msg)) != strlen(win_msg)){
-			perror("announce winner");
-			exit(1);
-		}
+		queue_message(every_p, every_p == winner ? win_msg : lose_msg);
 	}
-	broadcast(game, "Let's start a new game\n");
+	release_message(win_msg);
+	release_message(lose_msg);
 	// print message in the server window.
 	printf("Game over. %s won!\n", winner->name);
 	printf("%s\n", "New game.");
@@ -170,9 +382,8 @@ void announce_winner(struct game_state *game, struct client *winner){
  * announce that game is over and begin a new game.
  */
 void announce_game_over(struct game_state *game){
-	broadcast(game, "No more guesses.  The word was ");
-	broadcast(game, game->word);
-	broadcast(game, "\n\nLet's start a new game.\n");
+	broadcast_message(game, new_message("No more guesses.  The word was %s"
+		"\n\nLet's start a new game.\n", game->word));
 	printf("%s\n", "Evaluating for game_over");
 	printf("%s\n", "New game.");
 }
@@ -184,10 +395,7 @@ void announce_guess_invalid(struct client *current_player){
 	char guess_msg[MAX_MSG];
 	strcpy(guess_msg, current_player->inbuf);
 	strcat(guess_msg, " is not in the word\n");\
-	if(write(current_player->fd, guess_msg, strlen(guess_msg)) != strlen(guess_msg)){
-		perror("announce invalid guess");
-		exit(1);
-	}
+	send_to(current_player, guess_msg);
 	printf("%s",guess_msg);
 }
 
@@ -227,314 +435,527 @@ void announce_not_your_turn(struct client *player){
 	printf("Player %s tried to guess out of turn\n", player->name);
 	char* message;
 	message = "It is not your turn.\n";
-	if(write(player->fd, message, strlen(message)) != strlen(message)){
-		perror("announce out of turn");
-		exit(1);
-	}
+	send_to(player, message);
 }
 
 
-int main(int argc, char **argv) {
-    int clientfd, maxfd, nready;
-    struct client *p;
+/*
+ * Put p, who is in no list, in the lobby of r.
+ */
+void join_lobby(struct reactor *r, struct client *p) {
+    p->prev = NULL;
+    p->next = r->new_players;
+    if (r->new_players != NULL) {
+        r->new_players->prev = p;
+    }
+    r->new_players = p;
+}
+
+/*
+ * Take p out of the lobby of r, without walking it.
+ */
+void leave_lobby(struct reactor *r, struct client *p) {
+    if (p->prev != NULL) {
+        p->prev->next = p->next;
+    } else {
+        r->new_players = p->next;
+    }
+    if (p->next != NULL) {
+        p->next->prev = p->prev;
+    }
+}
+
+
+/*
+ * Remove the clients marked dead in this pass of the event loop. When the
+ * player whose turn it was is removed, the turn passes on and everyone in
+ * the room is told.
+ */
+void remove_dead_clients(struct reactor *r) {
+    // Clients that die while these are removed are left for the next call,
+    // after their output has been flushed, so none of these is dirty
+    struct client *dead = dead_clients;
+    dead_clients = NULL;
+    while (dead != NULL) {
+        struct client *p = dead;
+        dead = p->next_dead;
+        if (p->room == NULL) {
+            // p never got out of the lobby
+            leave_lobby(r, p);
+            close_player(p);
+            continue;
+        }
+        struct room *room = p->room;
+        struct game_state *game = &room->game;
+        int had_turn = game->has_next_turn == p;
+        if (had_turn) {
+            advance_turn(game);
+            if (game->has_next_turn == p) {
+                game->has_next_turn = p->next;
+            }
+        }
+        remove_player(&(game->head), p->fd);
+        leave_seat(&r->pool, room);
+        if (had_turn && game->has_next_turn != NULL) {
+            announce_turn(game);
+        }
+    }
+}
+
+/*
+ * Read what client p has sent into its inbuf. A line is complete when the
+ * input ends in "\r\n"; it is then NUL-terminated in place of the "\r\n"
+ * and in_ptr goes back to the start of inbuf.
+ * Return 1 if a line is complete, 0 if more input is needed and -1 if the
+ * client has disconnected.
+ */
+int read_line(struct client *p) {
+    int room = MAX_BUF - 1 - (p->in_ptr - p->inbuf);
+    if (room == 0) {
+        // Too long to be a name or a guess: start over
+        p->in_ptr = p->inbuf;
+        room = MAX_BUF - 1;
+    }
+    int read_num = read(p->fd, p->in_ptr, room);
+    if (read_num == -1) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+            return 0;
+        }
+        perror("read from client");
+        return -1;
+    } else if (read_num == 0) {
+        return -1;
+    }
+    printf("[%d] Read %d bytes\n", p->fd, read_num);
+    p->in_ptr += read_num;
+    if (p->in_ptr - p->inbuf >= 2 && *(p->in_ptr - 1) == '\n' && *(p->in_ptr - 2) == '\r') {
+        *(p->in_ptr - 2) = '\0';
+        p->in_ptr = p->inbuf;
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * Accept every pending connection on the listening socket of r as a new
+ * player in its lobby, and greet it. Connections that come while the
+ * process is out of descriptors are refused, so the queue is drained.
+ */
+void accept_players(struct reactor *r) {
     struct sockaddr_in q;
-    fd_set rset;
-    
-    if(argc != 2){
-        fprintf(stderr,"Usage: %s <dictionary filename>\n", argv[0]);
-        exit(1);
+    int clientfd;
+    while ((clientfd = accept_nonblocking(r->listenfd, &q, &r->spare_fd)) != -1) {
+        printf("Connection from %s\n", inet_ntoa(q.sin_addr));
+        struct client *p = NULL;
+        add_player(&p, clientfd, q.sin_addr);
+        join_lobby(r, p);
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.ptr = p;
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, clientfd, &ev) == -1) {
+            perror("epoll_ctl");
+            exit(1);
+        }
+        send_to(p, WELCOME_MSG);
     }
-    
-    // Create and initialize the game state
-    struct game_state game;
+}
 
-    srandom((unsigned int)time(NULL));
-    // Set up the file pointer outside of init_game because we want to 
-    // just rewind the file when we need to pick a new word
-    game.dict.fp = NULL;
-    game.dict.size = get_file_length(argv[1]);
+/*
+ * Handle input from p, a player in the game.
+ */
+void handle_player(struct game_state *game, struct client *p) {
+    int status = read_line(p);
+    if (status == -1) {
+        printf("Disconnect from %s\n", inet_ntoa(p->ipaddr));
+        drop_client(p);
+        return;
+    } else if (status == 0) {
+        return;
+    }
 
-    init_game(&game, argv[1]);
-    
-    // head and has_next_turn also don't change when a subsequent game is
-    // started so we initialize them here.
-    game.head = NULL;
-    game.has_next_turn = NULL;
-    
-    /* A list of client who have not yet entered their name.  This list is
-     * kept separate from the list of active players in the game, because
-     * until the new playrs have entered a name, they should not have a turn
-     * or receive broadcast messages.  In other words, they can't play until
-     * they have a name.
-     */
-    struct client *new_players = NULL;
-    
-    struct sockaddr_in *server = init_server_addr(PORT);
-    int listenfd = set_up_server_socket(server, MAX_QUEUE);
-    
-    // initialize allset and add listenfd to the
-    // set of file descriptors passed into select
-    FD_ZERO(&allset);
-    FD_SET(listenfd, &allset);
-    // maxfd identifies how far into the set to search
-    maxfd = listenfd;
+    if (game->has_next_turn != p) {
+        // a player out of turn guessed a letter, so send them a warning
+        announce_not_your_turn(p);
+        return;
+    }
+    printf("[%d] Found newline %s\n", p->fd, p->inbuf);
+    // check whether the guess is invalid
+    char *guess_inv_msg = NULL;
+    if (strlen(p->inbuf) != 1) {
+        guess_inv_msg = "guess length should be 1.\n";
+    } else if (p->inbuf[0] < 'a' || p->inbuf[0] > 'z') {
+        guess_inv_msg = "guess should be a letter in lower case.\n";
+    } else if (game->letters_guessed[p->inbuf[0] - 'a'] == 1) {
+        guess_inv_msg = "This letter has been guessed.\n";
+    }
+    if (guess_inv_msg != NULL) {
+        send_to(p, guess_inv_msg);
+        return;
+    }
 
-    while (1) {
-        // make a copy of the set before we pass it into select
-        rset = allset;
-        nready = select(maxfd + 1, &rset, NULL, NULL, NULL);
-        if (nready == -1) {
-            perror("select");
+    //update the game state
+    int incorrect_guess = !play_letter(game, p->inbuf[0]);
+    int win = strchr(game->guess, '-') == NULL;
+    advance_turn(game);
+    if (incorrect_guess) {
+        announce_guess_invalid(p);
+    }
+
+    //check whether the game ends
+    if (win) {
+        //if someone win
+        //announce it and begin a new game
+        announce_winner(game, p);
+        init_game(game);
+    } else if (game->guesses_left <= 0) {
+        //if game is over and player did not find the answer
+        //announce it and begin a new game
+        announce_game_over(game);
+        init_game(game);
+    } else {
+        announce_letter_guessed(game, p);
+    }
+    announce_game_state(game);
+    announce_turn(game);
+}
+
+/*
+ * Seat p, who has entered a name and is in no list, in a room of r with a
+ * free seat. If someone in that room already has the name, p goes back to
+ * the lobby of r to enter another.
+ */
+void seat_player(struct reactor *r, struct client *p) {
+    struct room *room = get_open_room(&r->pool);
+    struct game_state *game = &room->game;
+    for (struct client *every_p = game->head; every_p != NULL; every_p = every_p->next) {
+        if (strcmp(every_p->name, p->name) == 0) {
+            // tell the new player to enter the username again
+            p->name[0] = '\0';
+            join_lobby(r, p);
+            send_to(p, RETYPE_MSG);
+            return;
+        }
+    }
+
+    // put p at the head of the game
+    p->next = game->head;
+    game->head = p;
+    p->room = room;
+    take_seat(&r->pool, room);
+    // After put the new client into game, tell who will be the next player.
+    if (game->has_next_turn == NULL) {
+        game->has_next_turn = game->head;
+    }
+
+    char message[MAX_MSG];
+    strcpy(message, p->name);
+    strncat(message, " has just joined.\n", sizeof(message) - strlen(message) - 1);
+    // tell everyone in game that a new player joined.
+    broadcast(game, message);
+    // print message in the server window
+    printf("%s", message);
+    // tell the player who just joined the game with the current game state
+    char status_msg[MAX_MSG];
+    status_message(status_msg, game);
+    send_to(p, status_msg);
+    // tell everyone in game who is next.
+    announce_turn(game);
+}
+
+/*
+ * Send p, who has entered a name and is in no list, to another reactor
+ * with a free seat in an open room, so rooms fill up before new ones are
+ * opened. Return 1 if p was sent, or 0 if no reactor had a seat to spare.
+ * p must have no output waiting: messages are shared between the clients
+ * of one reactor only. From the moment p is in the other reactor's inbox,
+ * only that reactor may touch it.
+ */
+int send_to_reactor(struct reactor *r, struct client *p) {
+    for (int i = 1; i < num_reactors; i++) {
+        struct reactor *to = &reactors[(r->id + i) % num_reactors];
+        if (!claim_seat(&to->pool)) {
             continue;
         }
+        if (epoll_ctl(epfd, EPOLL_CTL_DEL, p->fd, NULL) == -1) {
+            perror("epoll_ctl");
+            exit(1);
+        }
+        printf("[%d] Sending %s to reactor %d\n", p->fd, p->name, to->id);
+        p->next = __atomic_load_n(&to->inbox, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&to->inbox, &p->next, p, 1,
+                                            __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+            ;
+        uint64_t one = 1;
+        if (write(to->wakefd, &one, sizeof(one)) != sizeof(one)) {
+            perror("write to eventfd");
+            exit(1);
+        }
+        return 1;
+    }
+    return 0;
+}
 
-        if (FD_ISSET(listenfd, &rset)){
-            printf("A new client is connecting\n");
-            clientfd = accept_connection(listenfd);
+/*
+ * Watch and seat the players other reactors have sent to r, in the order
+ * they were sent. A seat was claimed for each of them.
+ */
+void receive_players(struct reactor *r) {
+    uint64_t count;
+    if (read(r->wakefd, &count, sizeof(count)) == -1 && errno != EAGAIN) {
+        perror("read from eventfd");
+        exit(1);
+    }
+    // The inbox is a stack: take all of it and reverse it
+    struct client *p = __atomic_exchange_n(&r->inbox, NULL, __ATOMIC_ACQUIRE);
+    struct client *arrived = NULL;
+    while (p != NULL) {
+        struct client *next = p->next;
+        p->next = arrived;
+        arrived = p;
+        p = next;
+    }
+    while (arrived != NULL) {
+        p = arrived;
+        arrived = p->next;
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.ptr = p;
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, p->fd, &ev) == -1) {
+            perror("epoll_ctl");
+            exit(1);
+        }
+        settle_claim(&r->pool);
+        seat_player(r, p);
+    }
+}
 
-            FD_SET(clientfd, &allset);
-            if (clientfd > maxfd) {
-                maxfd = clientfd;
+/*
+ * Handle input from p, a client in the lobby of r who has not yet entered
+ * an acceptable name. Once they have, they join a room with a free seat,
+ * on another reactor if r has no open room and another has.
+ */
+void handle_new_player(struct reactor *r, struct client *p) {
+    int status = read_line(p);
+    if (status == -1) {
+        //new player disconnected
+        printf("Disconnect from %s\n", inet_ntoa(p->ipaddr));
+        drop_client(p);
+        return;
+    } else if (status == 0) {
+        return;
+    }
+
+    strncpy(p->name, p->inbuf, MAX_NAME - 1);
+    p->name[MAX_NAME - 1] = '\0';
+    printf("[%d] Found newline %s\n", p->fd, p->name);
+    if (strlen(p->name) == 0) {
+        // if the username is empty, tell the new player to enter the
+        // username again.
+        send_to(p, RETYPE_MSG);
+        return;
+    }
+
+    leave_lobby(r, p);
+    if (r->pool.open_rooms == NULL && p->out_count == 0 && !p->dirty
+        && send_to_reactor(r, p)) {
+        return;
+    }
+    seat_player(r, p);
+}
+
+
+/*
+ * Run the event loop of reactor r, on the thread calling it, forever.
+ */
+void *run_reactor(void *arg) {
+    struct reactor *r = arg;
+
+    // Watch the listening socket, level-triggered like everything else:
+    // accept_players drains the queue on every wakeup, and a connection it
+    // could not take wakes the loop again. Clients are level-triggered, so
+    // each wakeup reads once from every ready client and none can starve
+    // the others by sending a lot at once.
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epfd == -1) {
+        perror("epoll_create1");
+        exit(1);
+    }
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, r->listenfd, &ev) == -1) {
+        perror("epoll_ctl");
+        exit(1);
+    }
+    ev.events = EPOLLIN;
+    ev.data.ptr = r;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, r->wakefd, &ev) == -1) {
+        perror("epoll_ctl");
+        exit(1);
+    }
+
+    struct epoll_event events[MAX_EVENTS];
+    while (1) {
+        int nready = epoll_wait(epfd, events, MAX_EVENTS, -1);
+        if (nready == -1) {
+            if (errno != EINTR) {
+                perror("epoll_wait");
             }
-            printf("Connection from %s\n", inet_ntoa(q.sin_addr));
-            add_player(&new_players, clientfd, q.sin_addr);
-            char *greeting = WELCOME_MSG;
-            if(write(clientfd, greeting, strlen(greeting)) == -1) {
-                fprintf(stderr, "Write to client %s failed\n", inet_ntoa(q.sin_addr));
-                remove_player(&(game.head), p->fd);
-            };
+            continue;
         }
-        
-        /* Check which other socket descriptors have something ready to read.
-         * The reason we iterate over the rset descriptors at the top level and
-         * search through the two lists of clients each time is that it is
-         * possible that a client will be removed in the middle of one of the
-         * operations. This is also why we call break after handling the input.
-         * If a client has been removed the loop variables may not longer be 
-         * valid.
+
+        /* Each event carries the client it is for, or r for the eventfd.
+         * Clients that fail are only marked dead while the events are
+         * handled and removed after, so the clients of the events still to
+         * be handled are valid.
          */
-        int cur_fd;
-        for(cur_fd = 0; cur_fd <= maxfd; cur_fd++) {
-		if(FD_ISSET(cur_fd, &rset)) {
-                // Check if this socket descriptor is an active player
-                for(p = game.head; p != NULL; p = p->next) {
-                	if(cur_fd == p->fd) {
-						// handle input from an active client
-						if(game.has_next_turn->fd == p->fd){
-							//if the play is in his/her turn
-							int read_num;
-							read_num = read(p->fd, p->in_ptr, MAX_BUF);
-							if(read_num ==-1) {
-								perror("read letter from player in turn");
-								exit(1);
-							}else if(read_num == 0){
-								printf("Disconnect form %s\n", inet_ntoa(p->ipaddr));
-								advance_turn(&game);
-								if(game.has_next_turn == p){
-									game.has_next_turn = p->next;
-								}
-								remove_player(&(game.head), p->fd);
-								break;
-							}else{
-								printf("[%d] Read %d bytes\n", p->fd, read_num);
-								p->in_ptr += read_num;
-								if(*(p->in_ptr - 1)== '\n' && *(p->in_ptr - 2)== '\r'){
-									// finish reading an entire line, and then remove 'enter'  ('\r\n')
-									*(p->in_ptr - 2) = '\0';
-									printf("[%d] Found newline %s\n", p->fd, p->inbuf);
-									p->in_ptr = p -> inbuf;
-									// check whether the guess is invalid
-									char *guess_inv_msg;
-									if(strlen(p->inbuf) != 1){
-										//length is not 1.
-										guess_inv_msg = "guess length should be 1.\n";
-										write(p->fd, guess_inv_msg, strlen(guess_inv_msg));
-									}else if((int) p->inbuf[0] < (int) 'a' || (int) p->inbuf[0] > (int) 'z'){
-										//input is not a lower case letter
-										guess_inv_msg = "guess should be a letter in lower case.\n";
-										write(p->fd, guess_inv_msg, strlen(guess_inv_msg));
-									}else if(game.letters_guessed[(int) p->inbuf[0] - (int) 'a'] == 1){
-										guess_inv_msg = "This letter has been guessed.\n";
-										write(p->fd, guess_inv_msg, strlen(guess_inv_msg));
-									}else{
-										//update the game state
-										game.letters_guessed[(int) p->inbuf[0] - (int) 'a'] = 1;
-										int incorrect_guess = 1;
-										int win = 1;
-										for(int i = 0; i< strlen(game.word); i++){
-											if(game.word[i] == p->inbuf[0]){
-												game.guess[i] = p->inbuf[0];
-												incorrect_guess = 0;
-											}
-											if(game.guess[i] == '-'){
-												win = 0;
-											}
-										}
-										game.guesses_left -= incorrect_guess;
-										advance_turn(&game);
-										if(incorrect_guess){
-											announce_guess_invalid(p);
-										}
-
-										//check whether the game ends
-										if(win){
-											//if someone win
-											//announce it and begin a new game
-											announce_winner(&game, p);
-											init_game(&game, argv[1]);
-										}else if(game.guesses_left <= 0){
-											//if game is over and player did not find the answer
-											//announce it and begin a new game
-											announce_game_over(&game);
-											init_game(&game, argv[1]);
-										}else{
-											announce_letter_guessed(&game, p);
-										}
-										announce_game_state(&game);
-										announce_turn(&game);
-									}
-								}
-							}
-						}else{
-							int read_num;
-							read_num = read(p->fd, p->in_ptr, MAX_BUF);
-							if(read_num == -1){
-								//check the error
-								perror("read letter form a player out of turn");
-								exit(1);
-							}else if(read_num == 0){
-								//if a player out of turn disconnect.
-								printf("Disconnect form %s\n", inet_ntoa(p->ipaddr));
-								remove_player(&(game.head), p->fd);
-								break;
-							}else{
-								//if a player out of turn guessed a letter, then send a warning message to the player
-								printf("[%d] Read %d bytes\n", p->fd, read_num);
-								p->in_ptr += read_num;
-								if(*(p->in_ptr - 1)== '\n' && *(p->in_ptr - 2)== '\r'){
-									// find an entire line from the player out of turn
-									*(p->in_ptr - 2) = '\0';
-									announce_not_your_turn(p);
-									p->in_ptr = p -> inbuf;
-								}
-							}
-						}
-					}
+        for (int i = 0; i < nready; i++) {
+            struct client *p = events[i].data.ptr;
+            if (p == NULL) {
+                accept_players(r);
+                continue;
+            }
+            if (events[i].data.ptr == r) {
+                receive_players(r);
+                continue;
+            }
+            if ((events[i].events & EPOLLOUT) && !p->dead) {
+                // p has caught up: write the rest of its output with the
+                // output of this pass
+                mark_dirty(p);
+            }
+            if ((events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) && !p->dead) {
+                if (p->room == NULL) {
+                    // a client in the lobby has no acceptable name yet
+                    handle_new_player(r, p);
+                } else {
+                    handle_player(&p->room->game, p);
                 }
+            }
+        }
+        // Removing a client can announce a new turn, and flushing can
+        // find more clients to remove
+        while (dirty_clients != NULL || dead_clients != NULL) {
+            flush_clients();
+            remove_dead_clients(r);
+        }
+    }
+    return NULL;
+}
 
-                // last_p pointers to previous player of player p.
-                struct client* last_p = NULL;
-                // Check if any new players are entering their names
-                for(p = new_players; p != NULL; p = p->next) {
-                    if(p == new_players -> next){
-                         last_p = new_players;
-                    }else if(p != new_players){
-                         last_p = last_p->next;
-                    }
-                    //find active players
-                    if(cur_fd == p->fd) {
-                        //handle input from an new client who has
-                        // not entered an acceptable name.
-                        int read_num = 0;
-                        int invalid = 0;
-                        read_num = read(p->fd, p->in_ptr, MAX_BUF);
-                        if(read_num == -1){
-                        	perror("read username from new player");
-                        	exit(1);
-                        }else if(read_num == 0){
-                        	//new player disconnected
-							printf("Disconnect form %s\n", inet_ntoa(p->ipaddr));
-							remove_player(&new_players, p->fd);
-							break;
-						}else{
-							printf("[%d] Read %d bytes\n", p->fd, read_num);
-		                	p->in_ptr += read_num;
-		                	if(*(p->in_ptr - 1)== '\n' && *(p->in_ptr - 2)== '\r'){
-		                		//find an entire line from new player and then remove '\r\n' to get the game
-								*(p->in_ptr - 2) = '\0';
-								strcpy(p->name, p->inbuf);
-								printf("[%d] Found newline %s\n",p->fd, p->name);
-
-								//check whether the name exists
-								for(struct client *every_p = game.head;
-									every_p != NULL;  every_p = every_p->next){
-									if(strcmp(every_p->name, p->name) == 0){
-										invalid = 1;
-										break;
-									}
-
-								}
-								//check whether the name is empty.
-								if(strlen(p->name) == 0){
-									invalid =1;
-								}
-								//Initialize the inbuf and in_ptr again
-								p->inbuf[0]  ='\0';
-								p->in_ptr = p->inbuf;
-
-								if(invalid){
-									// if the username is invalid, send a message to the new player and tell
-									// the player to enter the username again.
-									p->name[0] = '\0';
-									char *retype = RETYPE_MSG;
-									if(write(p->fd, retype, strlen(retype)) == -1) {
-										fprintf(stderr, "Write to client %s failed\n", inet_ntoa(q.sin_addr));
-										remove_player(&(game.head), p->fd);
-									}
-								} else{
-									//after entering a valid name
-									char message[MAX_MSG];
-									strcpy(message, p->name);
-									strncat(message, " has just joined.\n", sizeof(message)-strlen(message) -1);
-									//Declare a new client ,'new', and allocate memory for it
-									//Let it be same as p.
-									//Set it as new game.head.
-									struct client* new;
-									new = malloc(sizeof(struct client));
-									new->fd = p->fd;
-									new->ipaddr = q.sin_addr;
-									new->name[0] = '\0';
-									strcpy(new->name, p->name);
-									new->in_ptr = new->inbuf;
-									new->inbuf[0] = '\0';
-									new->next = game.head;
-									game.head = new;
-									// After put the new client into game, tell who will be the next player.
-									if(game.has_next_turn == NULL){
-										game.has_next_turn= game.head;
-									}
-									//remove p from new_players
-									if(last_p == NULL){
-										new_players = p->next ;
-										p->next = NULL;
-									}else{
-										last_p->next = p->next;
-										p->next = NULL;
-									}
-									// tell everyone in game that a new player joined.
-									broadcast(&game, message);
-									// print message in the server window
-									printf("%s", message);
-									// tell the player who just joined the game with the current game state
-									char status_msg[MAX_MSG];
-									char return_msg[MAX_MSG];
-									strcpy(return_msg, status_message(status_msg, &game));
-									write(p->fd, return_msg, strlen(return_msg));
-									// tell everyone in game who is next.
-									announce_turn(&game);
-									//free p
-									free(p);
-									break;
-								}
-		                	}
-						}
-                    }
 
-                }
+int main(int argc, char **argv) {
+    // In evil mode (-e) the word is not picked when a game starts: the
+    // server answers each guess so as to keep as many words as possible
+    // in play, using the engine of the hangman game.
+    // -l min[-max] plays only words of min to max letters, and -d only
+    // easy, medium or hard words; evil games ignore -d.
+    // -r sets the number of players in each room, and -q the length of
+    // the queue of connections waiting to be accepted.
+    // -t sets the number of reactor threads, one per CPU by default.
+    int evil = 0, bad_option = 0, backlog = MAX_QUEUE, seats = ROOM_SEATS;
+    int min_length = 1, max_length = MAX_WORD - 1;
+    enum difficulty difficulty = ANY_DIFFICULTY;
+    num_reactors = sysconf(_SC_NPROCESSORS_ONLN);
+    if(num_reactors < 1) {
+        num_reactors = 1;
+    }
+    int opt;
+    while((opt = getopt(argc, argv, "el:d:r:q:t:")) != -1) {
+        if(opt == 'e') {
+            evil = 1;
+        } else if(opt == 'l') {
+            char *end;
+            min_length = max_length = strtol(optarg, &end, 10);
+            if(*end == '-') {
+                max_length = strtol(end + 1, NULL, 10);
+            }
+        } else if(opt == 'd') {
+            if(strcmp(optarg, "easy") == 0) {
+                difficulty = EASY;
+            } else if(strcmp(optarg, "medium") == 0) {
+                difficulty = MEDIUM;
+            } else if(strcmp(optarg, "hard") == 0) {
+                difficulty = HARD;
+            } else {
+                bad_option = 1;
             }
+        } else if(opt == 'r') {
+            seats = strtol(optarg, NULL, 10);
+        } else if(opt == 'q') {
+            backlog = strtol(optarg, NULL, 10);
+        } else if(opt == 't') {
+            num_reactors = strtol(optarg, NULL, 10);
+        } else {
+            bad_option = 1;
         }
     }
-    return 0;
-}
+    if(bad_option || backlog < 1 || seats < 1 || num_reactors < 1 || min_length > max_length
+       || optind != argc - 1){
+        fprintf(stderr,"Usage: %s [-e] [-l min[-max]] [-d easy|medium|hard] [-r seats] [-q backlog] "
+                "[-t threads] <dictionary filename>\n", argv[0]);
+        exit(1);
+    }
+    
+    srandom((unsigned int)time(NULL));
+    // Load the dictionary once, outside of init_game, so that picking a
+    // new word is only an index into the word list. All rooms share it.
+    struct dict_file *dict = load_word_list(argv[optind], min_length, max_length,
+                                            evil ? ANY_DIFFICULTY : difficulty);
+    struct evil_engine *engine = evil ? init_evil_engine(dict) : NULL;
+
+    // Every client needs a descriptor, so allow as many as we may
+    struct rlimit limit;
+    if(getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
 
+    // A client that disconnects makes writes to it fail with EPIPE instead
+    signal(SIGPIPE, SIG_IGN);
 
+    // Set up every reactor before any runs, so any can send players to
+    // any other. Each listens on the port with a socket of its own.
+    reactors = calloc(num_reactors, sizeof(struct reactor));
+    if(reactors == NULL) {
+        perror("calloc");
+        exit(1);
+    }
+    struct sockaddr_in *server = init_server_addr(PORT);
+    for(int i = 0; i < num_reactors; i++) {
+        struct reactor *r = &reactors[i];
+        r->id = i;
+        r->listenfd = set_up_server_socket(server, backlog, num_reactors > 1);
+        int flags = fcntl(r->listenfd, F_GETFL);
+        if(flags == -1 || fcntl(r->listenfd, F_SETFL, flags | O_NONBLOCK) == -1) {
+            perror("fcntl");
+            exit(1);
+        }
+        r->spare_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+        if(r->spare_fd == -1) {
+            perror("/dev/null");
+            exit(1);
+        }
+        r->wakefd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if(r->wakefd == -1) {
+            perror("eventfd");
+            exit(1);
+        }
+        r->inbox = NULL;
+        r->new_players = NULL;
+        init_room_pool(&r->pool, seats, dict,
+                       engine == NULL || i == 0 ? engine : share_evil_engine(engine));
+    }
+
+    // The first reactor runs on this thread
+    for(int i = 1; i < num_reactors; i++) {
+        int err = pthread_create(&reactors[i].thread, NULL, run_reactor, &reactors[i]);
+        if(err != 0) {
+            errno = err;
+            perror("pthread_create");
+            exit(1);
+        }
+    }
+    run_reactor(&reactors[0]);
+    return 0;
+}